@@ -31,7 +31,7 @@ void test_traverse_rec(riff_handle *rh){
 	if(rh->ls_level == 0) {
 		printf("CHUNK_ID: TOTAL_CHUNK_SIZE [CHUNK_DATA_FROM_TO_POS]\n");
 		//output RIFF file header
-		printf("%s%s: %d [%d..%d]\n", indent, rh->h_id, rh->h_size, rh->pos_start, rh->pos_start + rh->size);
+		printf("%s%s: %d [%d..%d]\n", indent, rh->h_id, rh->h_size, rh->h_pos_start, rh->h_pos_start + RIFF_CHUNK_DATA_OFFSET + rh->h_size);
 		printf(" %sType: %s\n", indent, rh->h_type);
 	}
 	else {
@@ -106,6 +106,11 @@ void test(FILE *f){
 	nchunk++; //header can be seen as chunk
 	
 	test_traverse_rec(rh);
+	//further RIFF segments, e.g. AVI > 1GB
+	while(riff_seekNextSegment(rh) == RIFF_ERROR_NONE){
+		nchunk++;
+		test_traverse_rec(rh);
+	}
 	printf("\nlist chunks: %d\nchunks: %d\n", nlist, nchunk);
 	
 	int r;
@@ -154,6 +159,64 @@ void test(FILE *f){
 
 
 
+//append chunk header with little endian size to buffer, returns new end
+unsigned char *put_header(unsigned char *p, const char *id, unsigned int size){
+	memcpy(p, id, 4);
+	p[4] = size & 0xFF;
+	p[5] = (size >> 8) & 0xFF;
+	p[6] = (size >> 16) & 0xFF;
+	p[7] = (size >> 24) & 0xFF;
+	return p + 8;
+}
+
+//follow mode must stop each RIFF segment at its end if another one follows, and accept empty chunks
+//walks the top level chunks of a small AVI with two segments built in memory
+//returns 0 on success
+int test_follow(){
+	unsigned char buf[128];
+	unsigned char *p = buf;
+	memset(buf, 0, sizeof(buf));
+	
+	//segment 0: "LIST" "hdrl" with "avih", empty "JUNK", "idx1" with pad byte
+	p = put_header(p, "RIFF", 4 + 8+4+8+4 + 8 + 8+4);
+	memcpy(p, "AVI ", 4); p += 4;
+	p = put_header(p, "LIST", 4 + 8+4);
+	memcpy(p, "hdrl", 4); p += 4;
+	p = put_header(p, "avih", 4); p += 4;
+	p = put_header(p, "JUNK", 0);
+	p = put_header(p, "idx1", 3); p += 4;
+	//segment 1: "LIST" "movi" with "00dc"
+	p = put_header(p, "RIFF", 4 + 8+4+8+2);
+	memcpy(p, "AVIX", 4); p += 4;
+	p = put_header(p, "LIST", 4 + 8+2);
+	memcpy(p, "movi", 4); p += 4;
+	p = put_header(p, "00dc", 2); p += 2;
+	
+	const int expected[2] = {3, 1};  //top level chunks per segment
+	int n[2] = {0, 0};
+	
+	riff_handle *rh = riff_handleAllocate();
+	rh->follow = 1;
+	if(riff_open_mem(rh, buf, p - buf) != RIFF_ERROR_NONE){
+		riff_handleFree(rh);
+		return -1;
+	}
+	do {
+		do {
+			if(rh->h_seg < 2)
+				n[rh->h_seg]++;
+		} while(riff_seekNextChunk(rh) == RIFF_ERROR_NONE);
+	} while(riff_seekNextSegment(rh) == RIFF_ERROR_NONE);
+	int segs = rh->h_seg + 1;
+	riff_handleFree(rh);
+	
+	printf("Follow mode, segments: %d, top level chunks: %d %d (expected: 2, %d %d)\n", segs, n[0], n[1], expected[0], expected[1]);
+	return (segs == 2  &&  n[0] == expected[0]  &&  n[1] == expected[1]) ? 0 : -1;
+}
+
+
+
+
 int main(int argc, char *argv[] ){
 	if(argc < 2){
 		printf("Need path to input RIFF file!\n");
@@ -172,5 +235,10 @@ int main(int argc, char *argv[] ){
 	
 	fclose(f);
 	
+	if(test_follow() != 0){
+		printf("Follow mode test failed!\n");
+		return -1;
+	}
+	
 	return 0;
 }
@@ -3,6 +3,13 @@
 //   => to simplify user wrappers we update the positions outside
 
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  //preadv(), copy_file_range() with strict C99 compiler flags
+#endif
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64  //files > 2GB on 32 bit systems
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,8 +18,44 @@
 
 #include "riff.h"
 
+#ifdef RIFF_POSIX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#endif
+#if defined(RIFF_POSIX)  &&  defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#if !defined(RIFF_POSIX)  &&  defined(_WIN32)
+#include <io.h>  //_write()
+#endif
+
 
 #define RIFF_LEVEL_ALLOC 16  //number of stack elements allocated per step lock more when needing to enlarge (step)
+#define RIFF_IOV_BATCH 64    //max. number of buffers passed to a single preadv() call
+#define RIFF_COPY_BUFSIZE (1 << 20)  //buffer size for copying chunk data in user space, default block size of riff_prefetchStart()
+#define RIFF_PREFETCH_DEPTH 4        //default number of blocks of riff_prefetchStart()
+#define RIFF_PROBE_BUDGET (1 << 16)  //default prefix size read by riff_probe_path()
+
+
+//IDs of RIFF headers and the byte order of all size values in the file
+static const struct {
+	char id[5];
+	int be;
+} riff_magic[] = {
+	{"RIFF", 0},
+	{"RIFX", 1},  //big endian, e.g. Macromedia Director, some big endian hardware
+};
+
+int riff_magicOrder(const void *id);
+
+//byte order specific header parsers, selected on opening
+int riff_readChunkHeaderLE(riff_handle *rh);
+int riff_readChunkHeaderBE(riff_handle *rh);
+int riff_preadChunkHeaderLE(riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e);
+int riff_preadChunkHeaderBE(riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e);
 
 
 //table to translate Error code to string
@@ -37,9 +80,11 @@ static const char *riff_es[] = {
 	"File access failed",
 	//8
 	"Invalid riff_handle",
+	//9
+	"List nesting too deep",
 	
 	
-	//9
+	//10
 	//all other
 	"Unknown RIFF error"  
 };
@@ -70,10 +115,63 @@ size_t read_file(void *fh, void *ptr, size_t size){
 
 /*****************************************************************************/
 size_t seek_file(void *fh, size_t pos){
+#if defined(RIFF_POSIX)
+	fseeko((FILE*)fh, (off_t)pos, SEEK_SET);
+#elif defined(_WIN32)
+	_fseeki64((FILE*)fh, pos, SEEK_SET);
+#else
 	fseek((FILE*)fh, pos, SEEK_SET);
+#endif
 	return pos;
 }
 
+/*****************************************************************************/
+//positioned read via file descriptor, the FILE stream position and buffer stay untouched
+#ifdef RIFF_POSIX
+size_t readv_file(void *fh, const struct riff_iovec *iov, int iovcnt, size_t pos){
+	int fd = fileno((FILE*)fh);
+	struct iovec v[RIFF_IOV_BATCH];
+	size_t total = 0;
+	
+	while(iovcnt > 0){
+		int n = iovcnt < RIFF_IOV_BATCH ? iovcnt : RIFF_IOV_BATCH;
+		size_t want = 0;
+		int i;
+		for(i = 0; i < n; i++){
+			v[i].iov_base = iov[i].base;
+			v[i].iov_len = iov[i].len;
+			want += iov[i].len;
+		}
+		
+		ssize_t r = preadv(fd, v, n, pos + total);
+		if(r < 0  &&  errno == EINTR)
+			continue;
+		if(r <= 0)
+			break;
+		total += r;
+		if((size_t)r < want)
+			break; //end of file (or error), caller sees short count
+		iov += n;
+		iovcnt -= n;
+	}
+	return total;
+}
+
+/*****************************************************************************/
+size_t size_file(void *fh){
+	struct stat st;
+	if(fstat(fileno((FILE*)fh), &st) != 0)
+		return 0;
+	return st.st_size;
+}
+
+/*****************************************************************************/
+int fd_file(void *fh, size_t *offs){
+	*offs = 0; //positions are file offsets
+	return fileno((FILE*)fh);
+}
+#endif
+
 /*****************************************************************************/
 //description: see header file
 int riff_open_file(riff_handle *rh, FILE *f, size_t size){
@@ -82,10 +180,23 @@ int riff_open_file(riff_handle *rh, FILE *f, size_t size){
 	if(rh != NULL){
 		rh->fh = f;
 		rh->size = size;
-		rh->pos_start = ftell(f); //current file offset of stream considered as start of RIFF file
+		//current file offset of stream considered as start of RIFF file
+#if defined(RIFF_POSIX)
+		rh->pos_start = ftello(f);
+#elif defined(_WIN32)
+		rh->pos_start = _ftelli64(f);
+#else
+		rh->pos_start = ftell(f);
+#endif
+		rh->pos = rh->pos_start;  //positions are absolute file offsets
 		
 		rh->fp_read = &read_file;
 		rh->fp_seek = &seek_file;
+#ifdef RIFF_POSIX
+		rh->fp_readv = &readv_file;
+		rh->fp_fd = &fd_file;
+		rh->fp_size = &size_file;
+#endif
 		
 		riff_readHeader(rh);
 	}
@@ -97,29 +208,78 @@ int riff_open_file(riff_handle *rh, FILE *f, size_t size){
 //** memory **
 
 
+//state of memory backend
+struct riff_mem {
+	char *ptr;    //start of RIFF file in memory
+	size_t size;  //size of memory block
+	size_t pos;   //current position
+};
+
 /*****************************************************************************/
 size_t read_mem(void *fh, void *ptr, size_t size){
-	memcpy(ptr, fh, size);
+	struct riff_mem *m = (struct riff_mem*)fh;
+	if(m->pos >= m->size)
+		return 0;
+	if(size > m->size - m->pos)
+		size = m->size - m->pos;
+	memcpy(ptr, m->ptr + m->pos, size);
+	m->pos += size;
 	return size;
 }
 
 /*****************************************************************************/
 size_t seek_mem(void *fh, size_t pos){
+	((struct riff_mem*)fh)->pos = pos;
 	return pos; //instant in memory
 }
 
+/*****************************************************************************/
+size_t readv_mem(void *fh, const struct riff_iovec *iov, int iovcnt, size_t pos){
+	struct riff_mem *m = (struct riff_mem*)fh;
+	size_t total = 0;
+	int i;
+	for(i = 0; i < iovcnt  &&  pos + total < m->size; i++){
+		size_t len = iov[i].len;
+		if(len > m->size - pos - total)
+			len = m->size - pos - total;
+		memcpy(iov[i].base, m->ptr + pos + total, len);
+		total += len;
+	}
+	return total;
+}
+
+/*****************************************************************************/
+size_t size_mem(void *fh){
+	return ((struct riff_mem*)fh)->size;
+}
+
+/*****************************************************************************/
+void free_mem(void *fh){
+	free(fh);
+}
+
 /*****************************************************************************/
 //description: see header file
 int riff_open_mem(riff_handle *rh, void *ptr, size_t size){
 	if(rh == NULL)
 		return RIFF_ERROR_INVALID_HANDLE;
 	
-	rh->fh = ptr;
+	struct riff_mem *m = malloc(sizeof(struct riff_mem));
+	if(m == NULL)
+		return RIFF_ERROR_ACCESS;
+	m->ptr = ptr;
+	m->size = size;
+	m->pos = 0;
+	
+	rh->fh = m;
 	rh->size = size;
 	//rh->pos_start = 0 //redundant -> passed memory pointer is always expected to point to start of riff file
 	
 	rh->fp_read = &read_mem;
 	rh->fp_seek = &seek_mem;
+	rh->fp_readv = &readv_mem;
+	rh->fp_size = &size_mem;
+	rh->fp_free = &free_mem;
 	
 	riff_readHeader(rh);
 	
@@ -128,6 +288,131 @@ int riff_open_mem(riff_handle *rh, void *ptr, size_t size){
 
 
 
+//** window in chunk of other handle **
+
+
+//state of window backend
+struct riff_window {
+	riff_handle *parent;  //handle providing the data, must stay open while the window is used
+	size_t offs;          //start of window in parent stream
+	size_t size;          //size of window
+	size_t pos;           //current position in window
+};
+
+/*****************************************************************************/
+//read from parent at window position, the parent's stream position is kept
+size_t pread_window(struct riff_window *w, void *ptr, size_t size, size_t pos){
+	riff_handle *p = w->parent;
+	if(pos >= w->size)
+		return 0;
+	if(size > w->size - pos)
+		size = w->size - pos;
+	
+	if(p->fp_readv != NULL){
+		struct riff_iovec v = {ptr, size};
+		return p->fp_readv(p->fh, &v, 1, w->offs + pos);
+	}
+	p->fp_seek(p->fh, w->offs + pos);
+	size_t n = p->fp_read(p->fh, ptr, size);
+	p->fp_seek(p->fh, p->pos); //restore
+	return n;
+}
+
+/*****************************************************************************/
+size_t read_window(void *fh, void *ptr, size_t size){
+	struct riff_window *w = (struct riff_window*)fh;
+	size_t n = pread_window(w, ptr, size, w->pos);
+	w->pos += n;
+	return n;
+}
+
+/*****************************************************************************/
+size_t seek_window(void *fh, size_t pos){
+	((struct riff_window*)fh)->pos = pos;
+	return pos;
+}
+
+/*****************************************************************************/
+//only used if parent supports positioned reads
+size_t readv_window(void *fh, const struct riff_iovec *iov, int iovcnt, size_t pos){
+	struct riff_window *w = (struct riff_window*)fh;
+	size_t want = 0;
+	int i;
+	for(i = 0; i < iovcnt; i++)
+		want += iov[i].len;
+	
+	//pass through if completely inside window
+	if(pos <= w->size  &&  want <= w->size - pos)
+		return w->parent->fp_readv(w->parent->fh, iov, iovcnt, w->offs + pos);
+	
+	size_t n = 0;
+	for(i = 0; i < iovcnt; i++){
+		size_t r = pread_window(w, iov[i].base, iov[i].len, pos + n);
+		n += r;
+		if(r < iov[i].len)
+			break;
+	}
+	return n;
+}
+
+/*****************************************************************************/
+int fd_window(void *fh, size_t *offs){
+	struct riff_window *w = (struct riff_window*)fh;
+	if(w->parent->fp_fd == NULL)
+		return -1;
+	int fd = w->parent->fp_fd(w->parent->fh, offs);
+	*offs += w->offs;
+	return fd;
+}
+
+/*****************************************************************************/
+size_t size_window(void *fh){
+	return ((struct riff_window*)fh)->size;
+}
+
+/*****************************************************************************/
+void free_window(void *fh){
+	free(fh);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_open_subchunk(riff_handle *rh, riff_handle *parent){
+	if(rh == NULL  ||  parent == NULL  ||  parent->fp_read == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	
+	struct riff_window *w = malloc(sizeof(struct riff_window));
+	if(w == NULL)
+		return RIFF_ERROR_ACCESS;
+	
+	w->parent = parent;
+	w->pos = 0;
+	//nested RIFF chunk: window starts at its header, else the chunk data contains the RIFF file
+	if(riff_magicOrder(parent->c_id) >= 0){
+		w->offs = parent->c_pos_start;
+		w->size = RIFF_CHUNK_DATA_OFFSET + parent->c_size;
+	}
+	else {
+		w->offs = parent->c_pos_start + RIFF_CHUNK_DATA_OFFSET;
+		w->size = parent->c_size;
+	}
+	
+	rh->fh = w;
+	rh->size = w->size;
+	//rh->pos_start = 0 //window positions start at 0
+	
+	rh->fp_read = &read_window;
+	rh->fp_seek = &seek_window;
+	rh->fp_readv = (parent->fp_readv != NULL) ? &readv_window : NULL;
+	rh->fp_fd = &fd_window;
+	rh->fp_size = &size_window;
+	rh->fp_free = &free_window;
+	
+	return riff_readHeader(rh);
+}
+
+
+
 // **** internal ****
 
 
@@ -139,6 +424,44 @@ unsigned int convUInt32LE(void *p){
 	return c[0] | (c[1] << 8) | (c[2] << 16) | (c[3] << 24);
 }
 
+/*****************************************************************************/
+//pass pointer to 32 bit BE value and convert, return in native byte order
+unsigned int convUInt32BE(void *p){
+	unsigned char *c = (unsigned char*)p;
+	return (c[0] << 24) | (c[1] << 16) | (c[2] << 8) | c[3];
+}
+
+/*****************************************************************************/
+//convert 32 bit value in file byte order, be: 1 if big endian
+unsigned int riff_conv32(const void *p, int be){
+	return be ? convUInt32BE((void*)p) : convUInt32LE((void*)p);
+}
+
+/*****************************************************************************/
+//store 32 bit value in file byte order, be: 1 if big endian
+void riff_put32(void *p, size_t v, int be){
+	unsigned char *c = (unsigned char*)p;
+	int i;
+	for(i = 0; i < 4; i++)
+		c[be ? 3 - i : i] = (v >> (8 * i)) & 0xff;
+}
+
+/*****************************************************************************/
+//return byte order of RIFF header ID (0: little endian, 1: big endian), -1 if it is no RIFF header ID
+int riff_magicOrder(const void *id){
+	size_t i;
+	for(i = 0; i < sizeof(riff_magic) / sizeof(riff_magic[0]); i++)
+		if(memcmp(id, riff_magic[i].id, 4) == 0)
+			return riff_magic[i].be;
+	return -1;
+}
+
+/*****************************************************************************/
+//return 1 if a chunk with this ID contains sub chunks ("LIST" or nested RIFF header)
+int riff_isListID(const void *id){
+	return memcmp(id, "LIST", 4) == 0  ||  riff_magicOrder(id) >= 0;
+}
+
 
 /*****************************************************************************/
 //read 32 bit LE from file via FP and return as native
@@ -152,13 +475,123 @@ unsigned int readUInt32LE(riff_handle *rh){
 
 
 /*****************************************************************************/
-//read chunk header
-//return error code
-int riff_readChunkHeader(riff_handle *rh){
-	char buf[8];
+//read at absolute position without using rh->pos
+//without fp_readv the stream is moved, the caller must restore it
+size_t riff_pread(riff_handle *rh, void *ptr, size_t size, size_t pos){
+	if(rh->fp_readv != NULL){
+		struct riff_iovec v = {ptr, size};
+		return rh->fp_readv(rh->fh, &v, 1, pos);
+	}
+	rh->fp_seek(rh->fh, pos);
+	return rh->fp_read(rh->fh, ptr, size);
+}
+
+/*****************************************************************************/
+//read RIFF (segment) header, the stream must be positioned at pos
+//the handle is only changed on success, the first chunk header is not read
+//return error code, RIFF_ERROR_EOCL if no byte could be read
+int riff_readSegmentHeader(riff_handle *rh, size_t pos){
+	char buf[RIFF_HEADER_SIZE];
 	
-	int n = rh->fp_read(rh->fh, buf, 8);
+	size_t n = rh->fp_read(rh->fh, buf, RIFF_HEADER_SIZE);
+	if(n == 0)
+		return RIFF_ERROR_EOCL;
+	if(n != RIFF_HEADER_SIZE)
+		return RIFF_ERROR_EOF;
+	//byte order is picked by the first segment, all further segments must have the same ID
+	int be = riff_magicOrder(buf);
+	if(be < 0  ||  (pos != rh->pos_start  &&  memcmp(buf, rh->h_id, 4) != 0))
+		return RIFF_ERROR_ILLID;
+	if(pos == rh->pos_start){
+		rh->be = be;
+		rh->fp_readChunkHeader = be ? &riff_readChunkHeaderBE : &riff_readChunkHeaderLE;
+		rh->fp_preadChunkHeader = be ? &riff_preadChunkHeaderBE : &riff_preadChunkHeaderLE;
+	}
+	
+	rh->h_pos_start = pos;
+	memcpy(rh->h_id, buf, 4);
+	rh->h_size = riff_conv32(buf + 4, be);
+	memcpy(rh->h_type, buf + 8, 4);
+	rh->pos = pos + RIFF_HEADER_SIZE;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//end of available data in follow mode, (size_t)-1 if the size is unknown
+size_t riff_availEnd(riff_handle *rh){
+	return (rh->size > 0) ? rh->pos_start + rh->size : (size_t)-1;
+}
+
+/*****************************************************************************/
+//return 1 if another RIFF segment follows the current one
+int riff_segmentFollows(riff_handle *rh){
+	char buf[4];
+	size_t n = riff_pread(rh, buf, 4, rh->h_pos_start + RIFF_CHUNK_DATA_OFFSET + rh->h_size + (rh->h_size & 0x1));
+	if(rh->fp_readv == NULL)
+		rh->fp_seek(rh->fh, rh->pos);
+	return n == 4  &&  memcmp(buf, rh->h_id, 4) == 0;
+}
+
+/*****************************************************************************/
+//return 1 if chunk size value is a placeholder of a file still being written (follow mode)
+//0xFFFFFFFF always; 0 only where it can't be a valid size: lists (no space for the type ID)
+//and the chunk currently being written, the last one in available data (an empty chunk can't be told apart before data follows)
+//id, pos: ID and header position of the chunk
+int riff_isPlaceholder(riff_handle *rh, const char *id, size_t pos, size_t size){
+	if(size == 0xFFFFFFFF)
+		return 1;
+	return size == 0  &&  (riff_isListID(id)  ||  pos + RIFF_CHUNK_DATA_OFFSET >= riff_availEnd(rh));
+}
+
+/*****************************************************************************/
+//end of current list level without pad byte
+//in follow mode placeholder sizes and the RIFF segment reach up to the end of available data
+size_t riff_listEnd(riff_handle *rh){
+	size_t start, size;
+	const char *id;
+	if(rh->ls_level > 0){
+		struct riff_levelStackE *ls = rh->ls + (rh->ls_level - 1);
+		start = ls->c_pos_start;
+		size = ls->c_size;
+		id = (const char*)ls->c_id;
+	}
+	else {
+		start = rh->h_pos_start;
+		size = rh->h_size;
+		id = rh->h_id;
+	}
+	size_t listend = start + RIFF_CHUNK_DATA_OFFSET + size;
 	
+	if(rh->follow){
+		size_t avail = riff_availEnd(rh);
+		if(riff_isPlaceholder(rh, id, start, size))
+			listend = avail;
+		//a RIFF segment with outdated size is continued, if no other segment follows (same check as riff_followPoll())
+		//wait until the ID of a following segment would be complete
+		else if(rh->ls_level == 0  &&  listend < avail){
+			size_t next = listend + (size & 0x1);
+			if(avail >= next + 4  &&  !riff_segmentFollows(rh))
+				listend = avail;
+		}
+	}
+	return listend;
+}
+
+/*****************************************************************************/
+//bytes left to read in current chunk
+size_t riff_chunkLeft(riff_handle *rh){
+	//growing chunk in follow mode, up to end of available data
+	if(rh->follow  &&  riff_isPlaceholder(rh, rh->c_id, rh->c_pos_start, rh->c_size)){
+		size_t avail = riff_availEnd(rh);
+		return (avail > rh->pos) ? avail - rh->pos : 0;
+	}
+	return rh->c_size - rh->c_pos;
+}
+
+/*****************************************************************************/
+//check chunk header read by riff_readChunkHeaderLE/BE(), independent of byte order
+//buf: header bytes, n: number of bytes read, c_size: size value converted by the caller
+int riff_readChunkHeaderBody(riff_handle *rh, const char *buf, int n, size_t c_size){
 	if(n != 8){
 		if(rh->fp_printf)
 			rh->fp_printf("Failed to read header, %d of %d bytes read!\n", n, 8);
@@ -169,7 +602,7 @@ int riff_readChunkHeader(riff_handle *rh){
 	rh->pos += n;
 	
 	memcpy(rh->c_id, buf, 4);
-	rh->c_size = convUInt32LE(buf + 4);
+	rh->c_size = c_size;
 	rh->pad = rh->c_size & 0x1; //pad byte present if size is odd
 	rh->c_pos = 0;
 	
@@ -185,16 +618,13 @@ int riff_readChunkHeader(riff_handle *rh){
 	}
 	
 	
+	//chunk may still be written in follow mode
+	if(rh->follow)
+		return RIFF_ERROR_NONE;
+	
 	//check if chunk fits into current list level and file, value could be corrupt
 	size_t cposend = rh->c_pos_start + RIFF_CHUNK_DATA_OFFSET + rh->c_size + rh->pad;
-	
-	size_t listend;
-	if(rh->ls_level > 0){
-		struct riff_levelStackE *ls = rh->ls + (rh->ls_level - 1);
-		listend = ls->c_pos_start + RIFF_CHUNK_DATA_OFFSET + ls->c_size; //end of current list level without pad byte
-	}
-	else
-		listend = rh->pos_start + RIFF_CHUNK_DATA_OFFSET + rh->h_size;
+	size_t listend = riff_listEnd(rh);
 	
 	if(cposend > listend){
 		if(rh->fp_printf)
@@ -204,7 +634,7 @@ int riff_readChunkHeader(riff_handle *rh){
 	}
 	
 	//check chunk size against file size
-	if((rh->size > 0)  &&  (cposend > rh->size)){
+	if((rh->size > 0)  &&  (cposend > rh->pos_start + rh->size)){
 		if(rh->fp_printf)
 			rh->fp_printf("Chunk size exceeds file size! At least one size value must be corrupt!");
 		return RIFF_ERROR_EOF; //Or better RIFF_ERROR_ICSIZE?
@@ -213,6 +643,32 @@ int riff_readChunkHeader(riff_handle *rh){
 	return RIFF_ERROR_NONE;
 }
 
+/*****************************************************************************/
+//read chunk header of little endian file ("RIFF")
+int riff_readChunkHeaderLE(riff_handle *rh){
+	char buf[8] = {0};
+	int n = rh->fp_read(rh->fh, buf, 8);
+	return riff_readChunkHeaderBody(rh, buf, n, convUInt32LE(buf + 4));
+}
+
+/*****************************************************************************/
+//read chunk header of big endian file ("RIFX")
+int riff_readChunkHeaderBE(riff_handle *rh){
+	char buf[8] = {0};
+	int n = rh->fp_read(rh->fh, buf, 8);
+	return riff_readChunkHeaderBody(rh, buf, n, convUInt32BE(buf + 4));
+}
+
+/*****************************************************************************/
+//read chunk header with the parser selected for the file's byte order
+//if not set (handle not created by riff_handleAllocate()), by rh->be, little endian for a zeroed handle
+//return error code
+int riff_readChunkHeader(riff_handle *rh){
+	if(rh->fp_readChunkHeader == NULL)
+		return rh->be ? riff_readChunkHeaderBE(rh) : riff_readChunkHeaderLE(rh);
+	return rh->fp_readChunkHeader(rh);
+}
+
 
 /*****************************************************************************/
 //pop from level stack
@@ -275,6 +731,8 @@ riff_handle *riff_handleAllocate(){
 	riff_handle *rh = calloc(1, sizeof(riff_handle));
 	if(rh != NULL){
 		rh->fp_printf = riff_printf;
+		rh->fp_readChunkHeader = &riff_readChunkHeaderLE;
+		rh->fp_preadChunkHeader = &riff_preadChunkHeaderLE;
 	}
 	return rh;
 }
@@ -288,6 +746,9 @@ void riff_handleFree(riff_handle *rh){
 	//free stack
 	if(rh->ls != NULL)
 		free(rh->ls);
+	//free state of open-function
+	if(rh->fp_free != NULL)
+		rh->fp_free(rh->fh);
 	//free struct
 	free(rh);
 }
@@ -296,41 +757,35 @@ void riff_handleFree(riff_handle *rh){
 //description: see header file
 //shall be called only once by the open-function
 int riff_readHeader(riff_handle *rh){
-	char buf[RIFF_HEADER_SIZE];
-	
 	if(rh->fp_read == NULL) {
 		if(rh->fp_printf)
 			rh->fp_printf("I/O function pointer not set\n"); //fatal user error
 		return RIFF_ERROR_INVALID_HANDLE;
 	}
 	
-	int n = rh->fp_read(rh->fh, buf, RIFF_HEADER_SIZE);
-	rh->pos += n;
-	
-	if(n != RIFF_HEADER_SIZE){
+	int r = riff_readSegmentHeader(rh, rh->pos);
+	if(r != RIFF_ERROR_NONE){
+		if(r == RIFF_ERROR_ILLID){
+			if(rh->fp_printf)
+				rh->fp_printf("Invalid RIFF header\n");
+			return RIFF_ERROR_ILLID;
+		}
 		if(rh->fp_printf)
 			rh->fp_printf("Read error, failed to read RIFF header\n");
-		//printf("%d", n);
 		return RIFF_ERROR_EOF; //return error code
 	}
-	memcpy(rh->h_id, buf, 4);
-	rh->h_size = convUInt32LE(buf + 4);
-	memcpy(rh->h_type, buf + 8, 4);
-
-
-	if(strcmp(rh->h_id, "RIFF") != 0) {
-		if(rh->fp_printf)
-			rh->fp_printf("Invalid RIFF header\n");
-		return RIFF_ERROR_ILLID;
-	}
+	rh->h_seg = 0;
 	
-	int r = riff_readChunkHeader(rh);
+	r = riff_readChunkHeader(rh);
 	if(r != RIFF_ERROR_NONE)
 		return r;
 	
-	//compare with given file size
-	if(rh->size != 0){
+	//compare with given file size, header may not be up to date in follow mode
+	if(rh->size != 0  &&  !rh->follow){
 		if(rh->size != rh->h_size + RIFF_CHUNK_DATA_OFFSET){
+			//further RIFF segments may follow (e.g. AVI with AVIX extensions)
+			if(rh->size > rh->h_size + RIFF_CHUNK_DATA_OFFSET  &&  riff_segmentFollows(rh))
+				return RIFF_ERROR_NONE;
 			if(rh->fp_printf)
 				rh->fp_printf("RIFF header chunk size %d doesn't match file size %d!\n", rh->h_size + RIFF_CHUNK_DATA_OFFSET, rh->size);
 			if(rh->size >= rh->h_size + RIFF_CHUNK_DATA_OFFSET)
@@ -357,7 +812,7 @@ int riff_readHeader(riff_handle *rh){
 //read to memory block, returns number of successfully read bytes
 //keep track of position, do not read beyond end of chunk, pad byte is not read
 size_t riff_readInChunk(riff_handle *rh, void *to, size_t size){
-	size_t left = rh->c_size - rh->c_pos;
+	size_t left = riff_chunkLeft(rh);
 	if(left < size)
 		size = left;
 	size_t n = rh->fp_read(rh->fh, to, size);
@@ -366,13 +821,174 @@ size_t riff_readInChunk(riff_handle *rh, void *to, size_t size){
 	return n;
 }
 
+/*****************************************************************************/
+//description: see header file
+size_t riff_readAt(riff_handle *rh, void *to, size_t size, size_t pos){
+	size_t n = riff_pread(rh, to, size, pos);
+	if(rh->fp_readv == NULL)
+		rh->fp_seek(rh->fh, rh->pos);
+	return n;
+}
+
+/*****************************************************************************/
+//scatter read to several memory blocks, returns number of successfully read bytes
+//same position keeping and chunk boundary as riff_readInChunk(), buffers beyond the end of chunk stay untouched
+size_t riff_readvInChunk(riff_handle *rh, const struct riff_iovec *iov, int iovcnt){
+	size_t left = riff_chunkLeft(rh);
+	size_t lastlen = 0;  //bytes to read into the last used buffer
+	size_t n = 0;
+	int cnt = 0;
+	int i;
+	
+	//count buffers fitting into chunk, the last one may be cut
+	for(i = 0; i < iovcnt; i++){
+		cnt++;
+		if(iov[i].len >= left){
+			lastlen = left;
+			break;
+		}
+		left -= iov[i].len;
+		lastlen = iov[i].len;
+	}
+	
+	if(cnt == 0)
+		return 0;
+	
+	if(rh->fp_readv != NULL){
+		if(lastlen != iov[cnt - 1].len){
+			//cut last buffer, requires a modified copy of the vector
+			struct riff_iovec vs[RIFF_IOV_BATCH];
+			struct riff_iovec *vc = vs;
+			if(cnt > RIFF_IOV_BATCH  &&  (vc = malloc(cnt * sizeof(struct riff_iovec))) == NULL)
+				return 0;
+			memcpy(vc, iov, cnt * sizeof(struct riff_iovec));
+			vc[cnt - 1].len = lastlen;
+			n = rh->fp_readv(rh->fh, vc, cnt, rh->pos);
+			if(vc != vs)
+				free(vc);
+		}
+		else
+			n = rh->fp_readv(rh->fh, iov, cnt, rh->pos);
+		
+		//positioned read doesn't move the stream
+		rh->fp_seek(rh->fh, rh->pos + n);
+	}
+	else {
+		for(i = 0; i < cnt; i++){
+			size_t len = (i == cnt - 1) ? lastlen : iov[i].len;
+			size_t r = rh->fp_read(rh->fh, iov[i].base, len);
+			n += r;
+			if(r < len)
+				break;
+		}
+	}
+	
+	rh->pos += n;
+	rh->c_pos += n;
+	return n;
+}
+
+/*****************************************************************************/
+//write all bytes, return number of bytes written
+//without POSIX or Windows there are no file descriptors, nothing is written
+size_t riff_writeAll(int fd, const char *buf, size_t size){
+	size_t n = 0;
+#if defined(RIFF_POSIX)
+	while(n < size){
+		ssize_t r = write(fd, buf + n, size - n);
+		if(r < 0  &&  errno == EINTR)
+			continue;
+		if(r <= 0)
+			break;
+		n += r;
+	}
+#elif defined(_WIN32)
+	while(n < size){
+		unsigned int part = (size - n < RIFF_COPY_BUFSIZE) ? (unsigned int)(size - n) : RIFF_COPY_BUFSIZE;
+		int r = _write(fd, buf + n, part);
+		if(r <= 0)
+			break;
+		n += r;
+	}
+#endif
+	return n;
+}
+
+/*****************************************************************************/
+//copy "len" bytes from stream position "pos" to file descriptor, in kernel space if possible
+//returns number of bytes written, the position in the handle is not changed
+size_t riff_copyRange(riff_handle *rh, int out_fd, size_t pos, size_t len){
+	size_t n = 0;
+	
+#if !defined(RIFF_POSIX)  &&  !defined(_WIN32)
+	//no file descriptors, nothing can be written, don't read the data
+	return n;
+#endif
+	
+#if defined(RIFF_POSIX)  &&  defined(__linux__)
+	size_t offs;
+	int in_fd = (rh->fp_fd != NULL) ? rh->fp_fd(rh->fh, &offs) : -1;
+	if(in_fd >= 0){
+		off_t off = pos + offs;
+		int use_sendfile = 0;
+		while(n < len){
+			ssize_t r;
+			if(!use_sendfile)
+				r = copy_file_range(in_fd, &off, out_fd, NULL, len - n, 0);
+			else
+				r = sendfile(out_fd, in_fd, &off, len - n);
+			if(r < 0  &&  errno == EINTR)
+				continue;
+			if(r < 0  &&  !use_sendfile){
+				//not supported for this pair of descriptors (e.g. socket or pipe as output), try sendfile()
+				use_sendfile = 1;
+				continue;
+			}
+			if(r <= 0)
+				break;  //failed or end of file, copy rest in user space
+			n += r;
+		}
+	}
+#endif
+	
+	if(n < len){
+		char *buf = malloc(len - n < RIFF_COPY_BUFSIZE ? len - n : RIFF_COPY_BUFSIZE);
+		if(buf == NULL)
+			return n;
+		while(n < len){
+			size_t size = len - n < RIFF_COPY_BUFSIZE ? len - n : RIFF_COPY_BUFSIZE;
+			size_t r = riff_pread(rh, buf, size, pos + n);
+			size_t w = riff_writeAll(out_fd, buf, r);
+			n += w;
+			if(r < size  ||  w < r)
+				break;
+		}
+		free(buf);
+		//restore stream position
+		if(rh->fp_readv == NULL)
+			rh->fp_seek(rh->fh, rh->pos);
+	}
+	
+	return n;
+}
+
+/*****************************************************************************/
+//description: see header file
+size_t riff_copyChunkTo(riff_handle *rh, int out_fd, size_t offset, size_t len){
+	if(offset >= rh->c_size)
+		return 0;
+	if(len > rh->c_size - offset)
+		len = rh->c_size - offset;
+	return riff_copyRange(rh, out_fd, rh->c_pos_start + RIFF_CHUNK_DATA_OFFSET + offset, len);
+}
+
 /*****************************************************************************/
 //seek byte position in current chunk data from start of chunk data, return error on failure
 //keep track of position
 //c_pos: relative offset from chunk data start
 int riff_seekInChunk(riff_handle *rh, size_t c_pos){
 	//seeking behind last byte is valid, next read at that pos will fail
-	if(c_pos < 0  ||  c_pos > rh->c_size){
+	if(c_pos < 0  ||  (c_pos > rh->c_size  &&  !(rh->follow  &&  riff_isPlaceholder(rh, rh->c_id, rh->c_pos_start, rh->c_size)))){
 		return RIFF_ERROR_EOC;
 	}
 	rh->pos = rh->c_pos_start + RIFF_CHUNK_DATA_OFFSET + c_pos;
@@ -386,14 +1002,11 @@ int riff_seekInChunk(riff_handle *rh, size_t c_pos){
 //description: see header file
 int riff_seekNextChunk(riff_handle *rh){
 	size_t posnew = rh->c_pos_start + RIFF_CHUNK_DATA_OFFSET + rh->c_size + rh->pad; //expected pos of following chunk
+	size_t listend = riff_listEnd(rh); //at level 0, end of current RIFF segment
 	
-	size_t listend;
-	if(rh->ls_level > 0){
-		struct riff_levelStackE *ls = rh->ls + (rh->ls_level - 1);
-		listend = ls->c_pos_start + RIFF_CHUNK_DATA_OFFSET + ls->c_size; //end of current list level without pad byte
-	}
-	else
-		listend = rh->pos_start + RIFF_CHUNK_DATA_OFFSET + rh->h_size; //at level 0
+	//end of growing chunk is unknown yet
+	if(rh->follow  &&  riff_isPlaceholder(rh, rh->c_id, rh->c_pos_start, rh->c_size))
+		return RIFF_ERROR_EOCL;
 	
 	//printf("listend %d  posnew %d\n", listend, posnew);  //debug
 	
@@ -427,12 +1040,55 @@ int riff_seekChunkStart(struct riff_handle *rh){
 }
 
 
+/*****************************************************************************/
+//description: see header file
+int riff_seekNextSegment(struct riff_handle *rh){
+	size_t posnew = rh->h_pos_start + RIFF_CHUNK_DATA_OFFSET + rh->h_size + (rh->h_size & 0x1); //expected pos of following segment
+	size_t fileend = rh->pos_start + rh->size;
+	
+	//no space left for another segment
+	if(rh->size > 0  &&  fileend < posnew + RIFF_HEADER_SIZE){
+		if(fileend > posnew){
+			if(rh->fp_printf)
+				rh->fp_printf("%d excess bytes at pos %d at end of file!\n", fileend - posnew, posnew);
+			return RIFF_ERROR_EXDAT;
+		}
+		return RIFF_ERROR_EOCL;
+	}
+	
+	rh->fp_seek(rh->fh, posnew);
+	int r = riff_readSegmentHeader(rh, posnew);
+	if(r != RIFF_ERROR_NONE){
+		rh->fp_seek(rh->fh, rh->pos); //stay in current segment
+		if(r == RIFF_ERROR_EOCL)
+			return RIFF_ERROR_EOCL;
+		if(rh->fp_printf)
+			rh->fp_printf("Excess bytes at pos %d at end of file, no RIFF header!\n", posnew);
+		return RIFF_ERROR_EXDAT;
+	}
+	
+	//leave sub lists of previous segment
+	rh->ls_level = 0;
+	rh->h_seg++;
+	
+	return riff_readChunkHeader(rh);
+}
+
+
 /*****************************************************************************/
 int riff_rewind(struct riff_handle *rh){
 	//pop stack as much as possible
 	while(rh->ls_level > 0) {
 		stack_pop(rh);
 	}
+	//back to first segment
+	if(rh->h_seg != 0){
+		rh->fp_seek(rh->fh, rh->pos_start);
+		int r = riff_readSegmentHeader(rh, rh->pos_start);
+		if(r != RIFF_ERROR_NONE)
+			return r;
+		rh->h_seg = 0;
+	}
 	return riff_seekLevelStart(rh);
 }
 
@@ -442,7 +1098,7 @@ int riff_seekLevelStart(struct riff_handle *rh){
 	if(rh->ls_level > 0)
 		rh->pos = rh->ls[rh->ls_level - 1].c_pos_start;
 	else
-		rh->pos = rh->pos_start;
+		rh->pos = rh->h_pos_start;
 		
 	rh->pos += RIFF_CHUNK_DATA_OFFSET + 4; //pos after type ID of chunk list
 	rh->c_pos = 0;
@@ -460,7 +1116,7 @@ int riff_seekLevelStart(struct riff_handle *rh){
 //description: see header file
 int riff_seekLevelSub(riff_handle *rh){
 	//according to "https://en.wikipedia.org/wiki/Resource_Interchange_File_Format" only RIFF and LIST chunk IDs can contain subchunks
-	if(strcmp(rh->c_id, "LIST") != 0  &&  strcmp(rh->c_id, "RIFF") != 0){
+	if(!riff_isListID(rh->c_id)){
 		if(rh->fp_printf)
 			rh->fp_printf("%s() failed for chunk ID \"%s\", only RIFF or LIST chunk can contain subchunks", __func__, rh->c_id);
 		return RIFF_ERROR_ILLID;
@@ -532,6 +1188,1595 @@ int riff_levelValidate(struct riff_handle *rh){
 }
 
 
+//** parallel validation **
+
+
+/*****************************************************************************/
+//return 1 if FOURCC contains only printable ASCII chars
+int riff_checkID(const unsigned char *id){
+	int i;
+	for(i = 0; i < 4; i++)
+		if(id[i] < 0x20  ||  id[i] > 0x7e)
+			return 0;
+	return 1;
+}
+
+/*****************************************************************************/
+//check chunk header read via positioned read by riff_preadChunkHeaderLE/BE(), same checks as riff_readChunkHeader()
+//buf: header bytes, n: number of bytes read, c_size: size value converted by the caller
+//listend: end of containing list without pad byte
+//e receives position, ID, size and the type ID of "LIST" and "RIFF" chunks (not checked, empty if not available)
+int riff_preadChunkHeaderBody(riff_handle *rh, const unsigned char *buf, size_t n, size_t c_size, size_t pos, size_t listend, struct riff_levelStackE *e){
+	memset(e, 0, sizeof(struct riff_levelStackE));
+	e->c_pos_start = pos;
+	if(n < RIFF_CHUNK_DATA_OFFSET)
+		return RIFF_ERROR_EOF;
+	
+	memcpy(e->c_id, buf, 4);
+	e->c_size = c_size;
+	if(!riff_checkID(buf))
+		return RIFF_ERROR_ILLID;
+	
+	size_t cposend = pos + RIFF_CHUNK_DATA_OFFSET + e->c_size + (e->c_size & 0x1);
+	if(cposend > listend)
+		return RIFF_ERROR_ICSIZE;
+	if((rh->size > 0)  &&  (cposend > rh->pos_start + rh->size))
+		return RIFF_ERROR_EOF;
+	
+	if(riff_isListID(buf)  &&  e->c_size >= 4  &&  n == RIFF_HEADER_SIZE)
+		memcpy(e->c_type, buf + 8, 4);
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//read and check chunk header at pos of little endian file ("RIFF")
+int riff_preadChunkHeaderLE(riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e){
+	unsigned char buf[RIFF_HEADER_SIZE] = {0};
+	size_t n = riff_pread(rh, buf, RIFF_HEADER_SIZE, pos);
+	return riff_preadChunkHeaderBody(rh, buf, n, convUInt32LE(buf + 4), pos, listend, e);
+}
+
+/*****************************************************************************/
+//read and check chunk header at pos of big endian file ("RIFX")
+int riff_preadChunkHeaderBE(riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e){
+	unsigned char buf[RIFF_HEADER_SIZE] = {0};
+	size_t n = riff_pread(rh, buf, RIFF_HEADER_SIZE, pos);
+	return riff_preadChunkHeaderBody(rh, buf, n, convUInt32BE(buf + 4), pos, listend, e);
+}
+
+/*****************************************************************************/
+//read and check chunk header at pos with the parser selected for the file's byte order, by rh->be if not set
+int riff_preadChunkHeader(riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e){
+	if(rh->fp_preadChunkHeader == NULL)
+		return rh->be ? riff_preadChunkHeaderBE(rh, pos, listend, e) : riff_preadChunkHeaderLE(rh, pos, listend, e);
+	return rh->fp_preadChunkHeader(rh, pos, listend, e);
+}
+
+/*****************************************************************************/
+//read and check chunk header for validation, including the type ID of chunks containing sub chunks (see riff_seekLevelSub())
+int riff_validateHeader(riff_handle *rh, size_t pos, size_t listend, struct riff_validateEntry *v){
+	struct riff_levelStackE e;
+	int r = riff_preadChunkHeader(rh, pos, listend, &e);
+	
+	memset(v, 0, sizeof(struct riff_validateEntry));
+	v->c_pos_start = pos;
+	if(r != RIFF_ERROR_NONE)
+		return r;
+	memcpy(v->c_id, e.c_id, 5);
+	v->c_size = e.c_size;
+	memcpy(v->c_type, e.c_type, 5);
+	
+	if(riff_isListID(v->c_id)){
+		if(v->c_size < 4)
+			return RIFF_ERROR_ICSIZE;
+		if(v->c_type[0] == '\0')
+			return RIFF_ERROR_EOF;
+		if(!riff_checkID(e.c_type))
+			return RIFF_ERROR_ILLID;
+	}
+	return RIFF_ERROR_NONE;
+}
+
+//list level of riff_validateSubtree()
+struct riff_validateLevel {
+	size_t end;   //end of list chunk without pad byte
+	size_t next;  //position of following chunk
+};
+
+/*****************************************************************************/
+//validate all sub chunks of top level list chunk
+//the list levels are tracked in a local stack, so this is independent of the handle's position
+void riff_validateSubtree(riff_handle *rh, struct riff_validateEntry *top){
+	struct riff_validateLevel lsbuf[RIFF_LEVEL_ALLOC];
+	struct riff_validateLevel *ls = lsbuf;
+	int ls_size = RIFF_LEVEL_ALLOC;
+	int level = 0;
+	size_t pos = top->c_pos_start + RIFF_HEADER_SIZE;
+	struct riff_validateEntry e;
+	int r;
+	
+	ls[0].end = top->c_pos_start + RIFF_CHUNK_DATA_OFFSET + top->c_size;
+	ls[0].next = ls[0].end + (top->c_size & 0x1);
+	level++;
+	
+	while(level > 0){
+		size_t listend = ls[level - 1].end;
+		
+		//end of current list level
+		if(listend < pos + RIFF_CHUNK_DATA_OFFSET){
+			if(listend > pos){
+				top->err = RIFF_ERROR_EXDAT;
+				top->err_pos = pos;
+				break;
+			}
+			level--;
+			pos = ls[level].next;
+			continue;
+		}
+		
+		r = riff_validateHeader(rh, pos, listend, &e);
+		if(r != RIFF_ERROR_NONE){
+			top->err = r;
+			top->err_pos = pos;
+			break;
+		}
+		top->n_chunks++;
+		
+		if(e.c_type[0] != '\0'){
+			//enter sub list, enlarge stack if needed
+			if(level == ls_size){
+				struct riff_validateLevel *lsnew = malloc(ls_size * 2 * sizeof(struct riff_validateLevel));
+				if(lsnew == NULL){
+					top->err = RIFF_ERROR_ACCESS;
+					top->err_pos = pos;
+					break;
+				}
+				memcpy(lsnew, ls, ls_size * sizeof(struct riff_validateLevel));
+				if(ls != lsbuf)
+					free(ls);
+				ls = lsnew;
+				ls_size *= 2;
+			}
+			ls[level].end = pos + RIFF_CHUNK_DATA_OFFSET + e.c_size;
+			ls[level].next = ls[level].end + (e.c_size & 0x1);
+			level++;
+			pos += RIFF_HEADER_SIZE;
+		}
+		else
+			pos += RIFF_CHUNK_DATA_OFFSET + e.c_size + (e.c_size & 0x1);
+	}
+	
+	if(ls != lsbuf)
+		free(ls);
+}
+
+#ifdef RIFF_POSIX
+//shared state of validation threads
+struct riff_validateJobs {
+	riff_handle *rh;
+	struct riff_validateReport *rep;
+	size_t next;            //next report entry to check
+	pthread_mutex_t mutex;  //protects "next"
+};
+
+/*****************************************************************************/
+void *riff_validateThread(void *arg){
+	struct riff_validateJobs *j = (struct riff_validateJobs*)arg;
+	while(1){
+		struct riff_validateEntry *e = NULL;
+		pthread_mutex_lock(&j->mutex);
+		while(j->next < j->rep->n  &&  e == NULL){
+			if(j->rep->e[j->next].c_type[0] != '\0'  &&  j->rep->e[j->next].err == RIFF_ERROR_NONE)
+				e = j->rep->e + j->next;
+			j->next++;
+		}
+		pthread_mutex_unlock(&j->mutex);
+		if(e == NULL)
+			return NULL;
+		riff_validateSubtree(j->rh, e);
+	}
+}
+#endif
+
+/*****************************************************************************/
+//description: see header file
+int riff_validateParallel(riff_handle *rh, int nthreads, struct riff_validateReport *rep){
+	if(rh == NULL  ||  rh->fp_read == NULL  ||  rep == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	memset(rep, 0, sizeof(struct riff_validateReport));
+	
+	//read table of top level chunks of all RIFF segments
+	size_t segpos = rh->pos_start;
+	size_t fileend = rh->pos_start + rh->size;
+	size_t n_alloc = 0;
+	int r = RIFF_ERROR_NONE;
+	
+	while(r == RIFF_ERROR_NONE){
+		unsigned char hdr[RIFF_HEADER_SIZE];
+		size_t n = 0;
+		
+		if(rh->size == 0  ||  fileend >= segpos + RIFF_HEADER_SIZE)
+			n = riff_pread(rh, hdr, RIFF_HEADER_SIZE, segpos);
+		if(n < RIFF_HEADER_SIZE  ||  memcmp(hdr, rh->h_id, 4) != 0){
+			//first segment is required, anything else is excess data at end of file
+			if(rep->n_seg == 0)
+				r = (n < RIFF_HEADER_SIZE) ? RIFF_ERROR_EOF : RIFF_ERROR_ILLID;
+			else if(n > 0  ||  (rh->size > 0  &&  fileend > segpos))
+				r = RIFF_ERROR_EXDAT;
+			if(r != RIFF_ERROR_NONE){
+				rep->err = r;
+				rep->err_pos = segpos;
+			}
+			break;
+		}
+		
+		size_t h_size = riff_conv32(hdr + 4, rh->be);
+		size_t listend = segpos + RIFF_CHUNK_DATA_OFFSET + h_size;
+		size_t pos = segpos + RIFF_HEADER_SIZE;
+		
+		while(listend >= pos + RIFF_CHUNK_DATA_OFFSET){
+			if(rep->n == n_alloc){
+				n_alloc = n_alloc ? n_alloc * 2 : RIFF_LEVEL_ALLOC;
+				struct riff_validateEntry *enew = realloc(rep->e, n_alloc * sizeof(struct riff_validateEntry));
+				if(enew == NULL){
+					r = RIFF_ERROR_ACCESS;
+					break;
+				}
+				rep->e = enew;
+			}
+			struct riff_validateEntry *e = rep->e + rep->n++;
+			r = riff_validateHeader(rh, pos, listend, e);
+			e->n_chunks = 1;
+			e->seg = rep->n_seg;
+			if(r != RIFF_ERROR_NONE){
+				e->err = r;
+				e->err_pos = pos;
+				break;
+			}
+			pos += RIFF_CHUNK_DATA_OFFSET + e->c_size + (e->c_size & 0x1);
+		}
+		if(r == RIFF_ERROR_ACCESS){
+			rep->err = r;
+			rep->err_pos = pos;
+		}
+		else if(r == RIFF_ERROR_NONE  &&  listend > pos  &&  rep->err == RIFF_ERROR_NONE){
+			//excess bytes at end of segment, not critical
+			rep->err = RIFF_ERROR_EXDAT;
+			rep->err_pos = pos;
+		}
+		
+		rep->n_seg++;
+		segpos = listend + (h_size & 0x1);
+	}
+	
+	//validate sub lists
+	int done = 0;
+#ifdef RIFF_POSIX
+	if(nthreads > 1  &&  rh->fp_readv != NULL){
+		struct riff_validateJobs j;
+		pthread_t *th = malloc((nthreads - 1) * sizeof(pthread_t));
+		int nstarted = 0;
+		j.rh = rh;
+		j.rep = rep;
+		j.next = 0;
+		pthread_mutex_init(&j.mutex, NULL);
+		if(th != NULL){
+			//start nthreads - 1 threads, the calling thread is the last worker
+			while(nstarted < nthreads - 1  &&  pthread_create(th + nstarted, NULL, riff_validateThread, &j) == 0)
+				nstarted++;
+			riff_validateThread(&j);
+			while(nstarted > 0)
+				pthread_join(th[--nstarted], NULL);
+			free(th);
+			done = 1;
+		}
+		pthread_mutex_destroy(&j.mutex);
+	}
+#endif
+	if(!done){
+		size_t i;
+		for(i = 0; i < rep->n; i++)
+			if(rep->e[i].c_type[0] != '\0'  &&  rep->e[i].err == RIFF_ERROR_NONE)
+				riff_validateSubtree(rh, rep->e + i);
+		//restore stream position
+		if(rh->fp_readv == NULL)
+			rh->fp_seek(rh->fh, rh->pos);
+	}
+	
+	//first error in file order
+	size_t i;
+	for(i = 0; i < rep->n; i++){
+		if(rep->e[i].err != RIFF_ERROR_NONE){
+			if(rep->err == RIFF_ERROR_NONE  ||  rep->e[i].err_pos < rep->err_pos){
+				rep->err = rep->e[i].err;
+				rep->err_pos = rep->e[i].err_pos;
+			}
+			break;
+		}
+	}
+	return rep->err;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_validateReportFree(struct riff_validateReport *rep){
+	if(rep == NULL)
+		return;
+	free(rep->e);
+	rep->e = NULL;
+	rep->n = 0;
+}
+
+//** cursors **
+
+
+/*****************************************************************************/
+//positioned read for cursors, the handle's stream is restored if needed
+size_t riff_cursorPread(riff_cursor *cur, void *ptr, size_t size, size_t pos){
+	return riff_readAt(cur->rh, ptr, size, pos);
+}
+
+/*****************************************************************************/
+//end of current list level without pad byte
+size_t riff_cursorListEnd(riff_cursor *cur){
+	if(cur->ls_level > 0){
+		struct riff_levelStackE *ls = cur->ls + (cur->ls_level - 1);
+		return ls->c_pos_start + RIFF_CHUNK_DATA_OFFSET + ls->c_size;
+	}
+	return cur->h_pos_start + RIFF_CHUNK_DATA_OFFSET + cur->h_size;
+}
+
+/*****************************************************************************/
+//read chunk header at pos and make it the current chunk
+int riff_cursorReadChunkHeader(riff_cursor *cur, size_t pos){
+	struct riff_levelStackE e;
+	int r = riff_preadChunkHeader(cur->rh, pos, riff_cursorListEnd(cur), &e);
+	if(cur->rh->fp_readv == NULL)
+		cur->rh->fp_seek(cur->rh->fh, cur->rh->pos);
+	if(r != RIFF_ERROR_NONE)
+		return r;
+	
+	cur->c_pos_start = pos;
+	memcpy(cur->c_id, e.c_id, 5);
+	cur->c_size = e.c_size;
+	cur->pad = cur->c_size & 0x1;
+	cur->c_pos = 0;
+	cur->pos = pos + RIFF_CHUNK_DATA_OFFSET;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorInit(riff_cursor *cur, riff_handle *rh){
+	if(cur == NULL  ||  rh == NULL  ||  rh->fp_read == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	if(rh->ls_level > RIFF_CURSOR_LEVELS)
+		return RIFF_ERROR_LEVEL;
+	
+	cur->rh = rh;
+	cur->h_pos_start = rh->h_pos_start;
+	cur->h_size = rh->h_size;
+	cur->pos = rh->pos;
+	cur->c_pos_start = rh->c_pos_start;
+	cur->c_pos = rh->c_pos;
+	memcpy(cur->c_id, rh->c_id, 5);
+	cur->c_size = rh->c_size;
+	cur->pad = rh->pad;
+	cur->ls_level = rh->ls_level;
+	if(rh->ls_level > 0)
+		memcpy(cur->ls, rh->ls, rh->ls_level * sizeof(struct riff_levelStackE));
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+size_t riff_cursorRead(riff_cursor *cur, void *to, size_t size){
+	size_t left = cur->c_size - cur->c_pos;
+	if(left < size)
+		size = left;
+	size_t n = riff_cursorPread(cur, to, size, cur->pos);
+	cur->pos += n;
+	cur->c_pos += n;
+	return n;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorSeekInChunk(riff_cursor *cur, size_t c_pos){
+	if(c_pos > cur->c_size)
+		return RIFF_ERROR_EOC;
+	cur->pos = cur->c_pos_start + RIFF_CHUNK_DATA_OFFSET + c_pos;
+	cur->c_pos = c_pos;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorNextChunk(riff_cursor *cur){
+	size_t posnew = cur->c_pos_start + RIFF_CHUNK_DATA_OFFSET + cur->c_size + cur->pad;
+	size_t listend = riff_cursorListEnd(cur);
+	
+	if(listend < posnew + RIFF_CHUNK_DATA_OFFSET){
+		if(listend > posnew)
+			return RIFF_ERROR_EXDAT;
+		return RIFF_ERROR_EOCL;
+	}
+	return riff_cursorReadChunkHeader(cur, posnew);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorNextSegment(riff_cursor *cur){
+	riff_handle *rh = cur->rh;
+	size_t posnew = cur->h_pos_start + RIFF_CHUNK_DATA_OFFSET + cur->h_size + (cur->h_size & 0x1);
+	unsigned char buf[RIFF_HEADER_SIZE];
+	
+	if(rh->size > 0  &&  rh->pos_start + rh->size < posnew + RIFF_HEADER_SIZE)
+		return (rh->pos_start + rh->size > posnew) ? RIFF_ERROR_EXDAT : RIFF_ERROR_EOCL;
+	
+	size_t n = riff_cursorPread(cur, buf, RIFF_HEADER_SIZE, posnew);
+	if(n == 0)
+		return RIFF_ERROR_EOCL;
+	if(n < RIFF_HEADER_SIZE  ||  memcmp(buf, rh->h_id, 4) != 0)
+		return RIFF_ERROR_EXDAT;
+	
+	riff_cursor c = *cur;
+	c.h_pos_start = posnew;
+	c.h_size = riff_conv32(buf + 4, rh->be);
+	c.ls_level = 0;
+	int r = riff_cursorReadChunkHeader(&c, posnew + RIFF_HEADER_SIZE);
+	if(r == RIFF_ERROR_NONE)
+		*cur = c;
+	return r;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorLevelStart(riff_cursor *cur){
+	size_t pos;
+	if(cur->ls_level > 0)
+		pos = cur->ls[cur->ls_level - 1].c_pos_start;
+	else
+		pos = cur->h_pos_start;
+	return riff_cursorReadChunkHeader(cur, pos + RIFF_HEADER_SIZE);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorLevelSub(riff_cursor *cur){
+	unsigned char type[4];
+	
+	if(!riff_isListID(cur->c_id))
+		return RIFF_ERROR_ILLID;
+	if(cur->c_size < 4)
+		return RIFF_ERROR_ICSIZE;
+	if(cur->ls_level >= RIFF_CURSOR_LEVELS)
+		return RIFF_ERROR_LEVEL;
+	if(riff_cursorPread(cur, type, 4, cur->c_pos_start + RIFF_CHUNK_DATA_OFFSET) != 4)
+		return RIFF_ERROR_EOF;
+	if(!riff_checkID(type))
+		return RIFF_ERROR_ILLID;
+	if(cur->c_size < 4 + RIFF_CHUNK_DATA_OFFSET)
+		return RIFF_ERROR_EOCL; //empty list
+	
+	//push
+	riff_cursor c = *cur;
+	struct riff_levelStackE *ls = c.ls + c.ls_level++;
+	ls->c_pos_start = c.c_pos_start;
+	memcpy(ls->c_id, c.c_id, 5);
+	ls->c_size = c.c_size;
+	memcpy(ls->c_type, type, 4);
+	ls->c_type[4] = '\0';
+	
+	int r = riff_cursorReadChunkHeader(&c, c.c_pos_start + RIFF_HEADER_SIZE);
+	if(r == RIFF_ERROR_NONE)
+		*cur = c;
+	return r;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_cursorLevelParent(riff_cursor *cur){
+	if(cur->ls_level <= 0)
+		return -1;  //not critical error, same as riff_levelParent()
+	cur->ls_level--;
+	struct riff_levelStackE *ls = cur->ls + cur->ls_level;
+	cur->c_pos_start = ls->c_pos_start;
+	memcpy(cur->c_id, ls->c_id, 5);
+	cur->c_size = ls->c_size;
+	cur->pad = cur->c_size & 0x1;
+	cur->c_pos = cur->pos - cur->c_pos_start - RIFF_CHUNK_DATA_OFFSET;
+	return RIFF_ERROR_NONE;
+}
+
+
+
+//** follow mode **
+
+
+//list level of riff_follow
+struct riff_followLevel {
+	size_t c_pos_start; //start of list chunk header
+	int grow;        //1 if size is a placeholder, checked again on each poll
+	size_t end;      //end of list without pad byte, (size_t)-1 if growing
+	size_t next;     //position after list
+	char c_type[5];  //type ID of list
+};
+
+//state of riff_followPoll()
+struct riff_follow {
+	riff_handle *rh;
+	size_t pos;         //position of next chunk header to parse
+	int level;          //number of entered lists, level 0 is the RIFF segment
+	struct riff_followLevel ls[RIFF_CURSOR_LEVELS + 1];
+	
+	int open;           //1 if the chunk at "pos" is parsed, but not complete yet
+	size_t c_end;       //end of open chunk data, (size_t)-1 if growing
+	size_t c_reported;  //data of open chunk reported up to this position
+	char c_id[5];       //ID of open chunk
+};
+
+/*****************************************************************************/
+//description: see header file
+struct riff_follow *riff_followStart(riff_handle *rh){
+	if(rh == NULL  ||  rh->fp_read == NULL)
+		return NULL;
+	struct riff_follow *fw = calloc(1, sizeof(struct riff_follow));
+	if(fw == NULL)
+		return NULL;
+	fw->rh = rh;
+	fw->pos = rh->pos_start;
+	rh->follow = 1;
+	return fw;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_followStop(struct riff_follow *fw){
+	free(fw);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_followPoll(struct riff_follow *fw, size_t avail, struct riff_followRange *out, int n_max, int *n){
+	riff_handle *rh = fw->rh;
+	unsigned char buf[RIFF_HEADER_SIZE];
+	int r = RIFF_ERROR_NONE;
+	
+	*n = 0;
+	if(avail == 0){
+		if(rh->fp_size == NULL)
+			return RIFF_ERROR_INVALID_HANDLE;
+		avail = rh->fp_size(rh->fh);
+	}
+	//new data is visible to the handle
+	if(avail > rh->pos_start)
+		rh->size = avail - rh->pos_start;
+	
+	//placeholder sizes (and the size of an extended RIFF segment) may have been written meanwhile
+	int i;
+	for(i = 0; i < fw->level; i++){
+		struct riff_followLevel *ls = fw->ls + i;
+		if(ls->grow  &&  riff_pread(rh, buf, 8, ls->c_pos_start) == 8){
+			size_t size = riff_conv32(buf + 4, rh->be);
+			if(!riff_isPlaceholder(rh, (char*)buf, ls->c_pos_start, size)){
+				ls->grow = 0;
+				ls->end = ls->c_pos_start + RIFF_CHUNK_DATA_OFFSET + size;
+				ls->next = ls->end + (size & 0x1);
+			}
+		}
+	}
+	//a chunk once taken as growing stays so while its size is 0
+	if(fw->open  &&  fw->c_end == (size_t)-1  &&  riff_pread(rh, buf, 4, fw->pos + 4) == 4){
+		size_t size = riff_conv32(buf, rh->be);
+		if(size != 0  &&  size != 0xFFFFFFFF)
+			fw->c_end = fw->pos + RIFF_CHUNK_DATA_OFFSET + size;
+	}
+	
+	while(*n < n_max){
+		//report new data of open chunk
+		if(fw->open){
+			size_t end = fw->c_end < avail ? fw->c_end : avail;
+			if(end > fw->c_reported){
+				struct riff_followRange *o = out + (*n)++;
+				o->c_pos_start = fw->pos;
+				memcpy(o->c_id, fw->c_id, 5);
+				memcpy(o->ls_type, fw->ls[fw->level - 1].c_type, 5);
+				o->level = fw->level - 1;
+				o->from = fw->c_reported;
+				o->to = end;
+				o->complete = (end == fw->c_end);
+				fw->c_reported = end;
+			}
+			//end of chunk whose data is reported already (empty chunk, placeholder size written later), empty range
+			else if(fw->c_end != (size_t)-1  &&  fw->c_reported >= fw->c_end){
+				struct riff_followRange *o = out + (*n)++;
+				o->c_pos_start = fw->pos;
+				memcpy(o->c_id, fw->c_id, 5);
+				memcpy(o->ls_type, fw->ls[fw->level - 1].c_type, 5);
+				o->level = fw->level - 1;
+				o->from = fw->c_end;
+				o->to = fw->c_end;
+				o->complete = 1;
+				fw->c_reported = fw->c_end;
+			}
+			if(fw->c_reported != fw->c_end)
+				break;  //still growing
+			fw->open = 0;
+			fw->pos = fw->c_end + (fw->c_end - fw->pos - RIFF_CHUNK_DATA_OFFSET) % 2;
+			continue;
+		}
+		
+		//leave completed lists
+		if(fw->level > 0){
+			struct riff_followLevel *ls = fw->ls + (fw->level - 1);
+			if(ls->end != (size_t)-1  &&  ls->end < fw->pos + RIFF_CHUNK_DATA_OFFSET){
+				//a RIFF segment with outdated size is continued, if no other segment follows
+				if(fw->level == 1){
+					if(avail < ls->next + 4)
+						break;
+					if(riff_pread(rh, buf, 4, ls->next) != 4)
+						break;
+					if(memcmp(buf, rh->h_id, 4) != 0){
+						//the size is read again on each poll, the final size and another segment may follow
+						ls->end = (size_t)-1;
+						ls->grow = 1;
+						continue;
+					}
+				}
+				fw->pos = ls->next;
+				fw->level--;
+				continue;
+			}
+		}
+		
+		//next header, "LIST" and "RIFF" need the type too
+		if(avail < fw->pos + RIFF_CHUNK_DATA_OFFSET)
+			break;
+		size_t nh = riff_pread(rh, buf, (avail < fw->pos + RIFF_HEADER_SIZE) ? RIFF_CHUNK_DATA_OFFSET : RIFF_HEADER_SIZE, fw->pos);
+		if(nh < RIFF_CHUNK_DATA_OFFSET)
+			break;
+		if(!riff_checkID(buf)){
+			r = RIFF_ERROR_ILLID;
+			break;
+		}
+		size_t size = riff_conv32(buf + 4, rh->be);
+		int list = riff_isListID(buf);
+		if(fw->level == 0  &&  memcmp(buf, rh->h_id, 4) != 0){
+			r = RIFF_ERROR_ILLID;
+			break;
+		}
+		
+		if(list){
+			if(nh < RIFF_HEADER_SIZE)
+				break;  //wait for type ID
+			if(fw->level > RIFF_CURSOR_LEVELS){
+				r = RIFF_ERROR_LEVEL;
+				break;
+			}
+			struct riff_followLevel *ls = fw->ls + fw->level++;
+			ls->c_pos_start = fw->pos;
+			ls->grow = riff_isPlaceholder(rh, (char*)buf, fw->pos, size);
+			if(ls->grow)
+				ls->end = (size_t)-1;
+			else
+				ls->end = fw->pos + RIFF_CHUNK_DATA_OFFSET + size;
+			ls->next = fw->pos + RIFF_CHUNK_DATA_OFFSET + size + (size & 0x1);
+			memcpy(ls->c_type, buf + 8, 4);
+			ls->c_type[4] = '\0';
+			fw->pos += RIFF_HEADER_SIZE;
+		}
+		else {
+			fw->open = 1;
+			memcpy(fw->c_id, buf, 4);
+			fw->c_id[4] = '\0';
+			fw->c_reported = fw->pos + RIFF_CHUNK_DATA_OFFSET;
+			fw->c_end = riff_isPlaceholder(rh, (char*)buf, fw->pos, size) ? (size_t)-1 : fw->c_reported + size;
+		}
+	}
+	
+	if(rh->fp_readv == NULL)
+		rh->fp_seek(rh->fh, rh->pos);
+	return r;
+}
+
+
+
+//** compaction **
+
+
+//output buffer of riff_compact()
+struct riff_compactOut {
+	FILE *f;
+	char *buf;     //block of RIFF_COPY_BUFSIZE bytes
+	size_t n;      //bytes in buffer
+	int err;       //write failed
+	int be;        //write sizes big endian
+};
+
+//state of riff_compact()
+struct riff_compact {
+	riff_handle *rh;
+	size_t align;
+	int write;            //0: planning pass, 1: writing pass
+	size_t *plan;         //new data size per chunk in traversal order, (size_t)-1 to drop chunk
+	size_t n_plan;
+	size_t n_alloc;
+	size_t i;             //current plan entry
+	size_t pos;           //output position
+	struct riff_compactOut out;
+};
+
+/*****************************************************************************/
+void riff_compactFlush(struct riff_compactOut *o){
+	if(o->n > 0  &&  fwrite(o->buf, 1, o->n, o->f) != o->n)
+		o->err = 1;
+	o->n = 0;
+}
+
+/*****************************************************************************/
+void riff_compactWrite(struct riff_compactOut *o, const void *ptr, size_t size){
+	while(size > 0){
+		size_t len = RIFF_COPY_BUFSIZE - o->n;
+		if(len > size)
+			len = size;
+		memcpy(o->buf + o->n, ptr, len);
+		o->n += len;
+		ptr = (const char*)ptr + len;
+		size -= len;
+		if(o->n == RIFF_COPY_BUFSIZE)
+			riff_compactFlush(o);
+	}
+}
+
+/*****************************************************************************/
+//write chunk header with 32 bit LE size
+void riff_compactWriteHeader(struct riff_compactOut *o, const char *id, size_t size){
+	unsigned char h[RIFF_CHUNK_DATA_OFFSET];
+	memcpy(h, id, 4);
+	riff_put32(h + 4, size, o->be);
+	riff_compactWrite(o, h, RIFF_CHUNK_DATA_OFFSET);
+}
+
+/*****************************************************************************/
+//return 1 if the current chunk is a filler chunk
+int riff_isFiller(riff_handle *rh){
+	return strcmp(rh->c_id, "JUNK") == 0  ||  strcmp(rh->c_id, "PAD ") == 0;
+}
+
+/*****************************************************************************/
+//return index of next plan entry, appended in planning pass, (size_t)-1 on allocation failure
+size_t riff_compactEntry(struct riff_compact *c){
+	if(!c->write  &&  c->n_plan == c->n_alloc){
+		size_t n_new = c->n_alloc ? c->n_alloc * 2 : 1024;
+		size_t *pnew = realloc(c->plan, n_new * sizeof(size_t));
+		if(pnew == NULL)
+			return (size_t)-1;
+		c->plan = pnew;
+		c->n_alloc = n_new;
+	}
+	if(!c->write)
+		c->n_plan++;
+	return c->i++;
+}
+
+/*****************************************************************************/
+//plan or write all chunks of the current list level, recursive for sub lists
+//returns error code
+int riff_compactLevel(struct riff_compact *c){
+	riff_handle *rh = c->rh;
+	int r;
+	
+	while(1){
+		size_t ie = riff_compactEntry(c);
+		if(ie == (size_t)-1)
+			return RIFF_ERROR_ACCESS;
+		
+		if(riff_isFiller(rh)){
+			if(!c->write){
+				//drop or shrink to alignment gap (at least a chunk header)
+				c->plan[ie] = (size_t)-1;
+				if(c->align > 0  &&  c->pos % c->align != 0){
+					size_t gap = c->align - c->pos % c->align;
+					while(gap < RIFF_CHUNK_DATA_OFFSET)
+						gap += c->align;
+					c->plan[ie] = gap - RIFF_CHUNK_DATA_OFFSET;
+				}
+			}
+			else if(c->plan[ie] != (size_t)-1){
+				char zero[256] = {0};
+				size_t n = c->plan[ie];
+				riff_compactWriteHeader(&c->out, rh->c_id, n);
+				while(n > 0){
+					size_t len = n < sizeof(zero) ? n : sizeof(zero);
+					riff_compactWrite(&c->out, zero, len);
+					n -= len;
+				}
+			}
+			if(c->plan[ie] != (size_t)-1)
+				c->pos += RIFF_CHUNK_DATA_OFFSET + c->plan[ie];
+		}
+		else if(riff_isListID(rh->c_id)  &&  rh->c_size > 4){
+			//sub list, size is known after its sub chunks
+			size_t start = c->pos;
+			if(c->write)
+				riff_compactWriteHeader(&c->out, rh->c_id, c->plan[ie]);
+			if((r = riff_seekLevelSub(rh)) != RIFF_ERROR_NONE)
+				return r;
+			if(c->write)
+				riff_compactWrite(&c->out, rh->ls[rh->ls_level - 1].c_type, 4);
+			c->pos += RIFF_HEADER_SIZE;
+			if((r = riff_compactLevel(c)) != RIFF_ERROR_NONE)
+				return r;
+			riff_levelParent(rh);
+			c->plan[ie] = c->pos - start - RIFF_CHUNK_DATA_OFFSET;
+		}
+		else {
+			//copy chunk, read directly into output buffer
+			if(c->write){
+				riff_compactWriteHeader(&c->out, rh->c_id, rh->c_size);
+				if(rh->c_pos != 0)
+					riff_seekChunkStart(rh);
+				while(rh->c_pos < rh->c_size){
+					if(c->out.n == RIFF_COPY_BUFSIZE)
+						riff_compactFlush(&c->out);
+					size_t n = riff_readInChunk(rh, c->out.buf + c->out.n, RIFF_COPY_BUFSIZE - c->out.n);
+					if(n == 0)
+						return RIFF_ERROR_EOF;
+					c->out.n += n;
+				}
+				if(rh->pad)
+					riff_compactWrite(&c->out, "", 1);
+			}
+			c->pos += RIFF_CHUNK_DATA_OFFSET + rh->c_size + rh->pad;
+		}
+		
+		if(c->out.err)
+			return RIFF_ERROR_ACCESS;
+		
+		r = riff_seekNextChunk(rh);
+		if(r == RIFF_ERROR_EOCL  ||  r == RIFF_ERROR_EXDAT)  //excess bytes are dropped
+			return RIFF_ERROR_NONE;
+		if(r != RIFF_ERROR_NONE)
+			return r;
+	}
+}
+
+/*****************************************************************************/
+//plan or write all RIFF segments
+int riff_compactFile(struct riff_compact *c){
+	riff_handle *rh = c->rh;
+	int r;
+	
+	c->i = 0;
+	c->pos = 0;
+	if((r = riff_rewind(rh)) != RIFF_ERROR_NONE)
+		return r;
+	
+	do {
+		size_t ie = riff_compactEntry(c);
+		if(ie == (size_t)-1)
+			return RIFF_ERROR_ACCESS;
+		if(c->write){
+			riff_compactWriteHeader(&c->out, rh->h_id, c->plan[ie]);
+			riff_compactWrite(&c->out, rh->h_type, 4);
+		}
+		
+		size_t start = c->pos;
+		c->pos += RIFF_HEADER_SIZE;
+		if((r = riff_compactLevel(c)) != RIFF_ERROR_NONE)
+			return r;
+		c->plan[ie] = c->pos - start - RIFF_CHUNK_DATA_OFFSET;
+	} while(riff_seekNextSegment(rh) == RIFF_ERROR_NONE);
+	
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_compact(riff_handle *rh, FILE *dst, const struct riff_compactPolicy *policy){
+	if(rh == NULL  ||  rh->fp_read == NULL  ||  dst == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	
+	struct riff_compact c;
+	memset(&c, 0, sizeof(c));
+	c.rh = rh;
+	if(policy != NULL)
+		c.align = (policy->align + 1) & ~(size_t)1;  //chunks start at even positions
+	c.out.f = dst;
+	c.out.be = rh->be;
+	c.out.buf = malloc(RIFF_COPY_BUFSIZE);
+	if(c.out.buf == NULL)
+		return RIFF_ERROR_ACCESS;
+	
+	//plan: walk chunk headers, compute new sizes
+	int r = riff_compactFile(&c);
+	
+	//write: stream data in file order
+	if(r == RIFF_ERROR_NONE){
+		c.write = 1;
+		r = riff_compactFile(&c);
+		riff_compactFlush(&c.out);
+		if(r == RIFF_ERROR_NONE  &&  c.out.err)
+			r = RIFF_ERROR_ACCESS;
+	}
+	
+	free(c.plan);
+	free(c.out.buf);
+	return r;
+}
+
+
+
+//** prefetching reader **
+
+//state of riff_prefetchStart()
+//blocks are numbered in file order, block i uses buffer i % depth
+struct riff_prefetch {
+	riff_handle *rh;
+	char *buf;           //depth * block_size bytes
+	size_t *size;        //bytes in each buffer
+	int depth;
+	size_t block_size;
+	size_t c_data;       //start of chunk data
+	size_t pos;          //position of next block to read
+	size_t end;          //end of chunk data
+	size_t pos_taken;    //position of next block to hand out
+	
+	size_t n_read;       //number of blocks read
+	size_t n_taken;      //number of blocks handed out
+	size_t n_released;   //number of blocks released
+	int done;            //no more blocks are read
+	int err;             //error code after the last block
+	
+	int threaded;        //1 if blocks are read by a background thread
+#ifdef RIFF_POSIX
+	int stop;
+	pthread_t th;
+	pthread_mutex_t mutex;  //protects the counters and flags
+	pthread_cond_t cond;    //signals a read or released block
+#endif
+};
+
+/*****************************************************************************/
+//read next block into its buffer, the caller must own the buffer
+//sets "done" and "err" after the last block, returns number of bytes read
+size_t riff_prefetchRead(struct riff_prefetch *pf, int *done, int *err){
+	size_t size = pf->end - pf->pos;
+	if(size > pf->block_size)
+		size = pf->block_size;
+	size_t n = riff_pread(pf->rh, pf->buf + (pf->n_read % pf->depth) * pf->block_size, size, pf->pos);
+	pf->size[pf->n_read % pf->depth] = n;
+	pf->pos += n;
+	*done = (n < size  ||  pf->pos >= pf->end);
+	*err = (n < size) ? RIFF_ERROR_EOF : RIFF_ERROR_EOC;
+	return n;
+}
+
+#ifdef RIFF_POSIX
+/*****************************************************************************/
+void *riff_prefetchThread(void *arg){
+	struct riff_prefetch *pf = (struct riff_prefetch*)arg;
+	int done = 0;
+	int err;
+	
+	while(!done){
+		pthread_mutex_lock(&pf->mutex);
+		while(pf->n_read - pf->n_released >= (size_t)pf->depth  &&  !pf->stop)
+			pthread_cond_wait(&pf->cond, &pf->mutex);
+		done = pf->stop;
+		pthread_mutex_unlock(&pf->mutex);
+		if(done)
+			break;
+		
+		//buffer is free, read without lock
+		size_t n = riff_prefetchRead(pf, &done, &err);
+		
+		pthread_mutex_lock(&pf->mutex);
+		if(n > 0)
+			pf->n_read++;
+		pf->done = done;
+		pf->err = err;
+		pthread_cond_broadcast(&pf->cond);
+		pthread_mutex_unlock(&pf->mutex);
+	}
+	return NULL;
+}
+#endif
+
+/*****************************************************************************/
+//description: see header file
+struct riff_prefetch *riff_prefetchStart(riff_handle *rh, int depth, size_t block_size){
+	if(rh == NULL  ||  rh->fp_read == NULL)
+		return NULL;
+	if(depth <= 0)
+		depth = RIFF_PREFETCH_DEPTH;
+	if(block_size == 0)
+		block_size = RIFF_COPY_BUFSIZE;
+	
+	struct riff_prefetch *pf = calloc(1, sizeof(struct riff_prefetch));
+	if(pf == NULL)
+		return NULL;
+	pf->buf = malloc(depth * block_size);
+	pf->size = malloc(depth * sizeof(size_t));
+	if(pf->buf == NULL  ||  pf->size == NULL){
+		free(pf->buf);
+		free(pf->size);
+		free(pf);
+		return NULL;
+	}
+	
+	pf->rh = rh;
+	pf->depth = depth;
+	pf->block_size = block_size;
+	pf->c_data = rh->c_pos_start + RIFF_CHUNK_DATA_OFFSET;
+	pf->pos = rh->pos;
+	pf->pos_taken = rh->pos;
+	pf->end = pf->c_data + rh->c_size;
+	pf->done = (pf->pos >= pf->end);
+	pf->err = RIFF_ERROR_EOC;
+	
+#ifdef RIFF_POSIX
+	//background reading needs positioned reads, the handle's stream stays untouched
+	if(rh->fp_readv != NULL  &&  !pf->done){
+		pthread_mutex_init(&pf->mutex, NULL);
+		pthread_cond_init(&pf->cond, NULL);
+		if(pthread_create(&pf->th, NULL, riff_prefetchThread, pf) == 0)
+			pf->threaded = 1;
+		else {
+			pthread_cond_destroy(&pf->cond);
+			pthread_mutex_destroy(&pf->mutex);
+		}
+	}
+#endif
+	return pf;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_prefetchNext(struct riff_prefetch *pf, struct riff_prefetchBlock *b){
+	int r = RIFF_ERROR_NONE;
+	
+	if(pf->n_taken - pf->n_released >= (size_t)pf->depth)
+		return RIFF_ERROR_ACCESS;  //all buffers held by the caller
+	
+#ifdef RIFF_POSIX
+	if(pf->threaded){
+		pthread_mutex_lock(&pf->mutex);
+		while(pf->n_taken == pf->n_read  &&  !pf->done)
+			pthread_cond_wait(&pf->cond, &pf->mutex);
+		if(pf->n_taken == pf->n_read)
+			r = pf->err;
+		pthread_mutex_unlock(&pf->mutex);
+	}
+	else
+#endif
+	if(pf->n_taken == pf->n_read){
+		//synchronous fallback, read in the calling thread
+		r = pf->err;
+		if(!pf->done){
+			if(riff_prefetchRead(pf, &pf->done, &pf->err) > 0){
+				pf->n_read++;
+				r = RIFF_ERROR_NONE;
+			}
+			else
+				r = pf->err;
+			if(pf->rh->fp_readv == NULL)
+				pf->rh->fp_seek(pf->rh->fh, pf->rh->pos);
+		}
+	}
+	
+	if(r != RIFF_ERROR_NONE)
+		return r;
+	
+	int i = pf->n_taken % pf->depth;
+	b->data = pf->buf + i * pf->block_size;
+	b->size = pf->size[i];
+	b->c_pos = pf->pos_taken - pf->c_data;
+	pf->pos_taken += b->size;
+	pf->n_taken++;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_prefetchRelease(struct riff_prefetch *pf){
+	if(pf->n_released == pf->n_taken)
+		return;
+#ifdef RIFF_POSIX
+	if(pf->threaded){
+		pthread_mutex_lock(&pf->mutex);
+		pf->n_released++;
+		pthread_cond_broadcast(&pf->cond);
+		pthread_mutex_unlock(&pf->mutex);
+		return;
+	}
+#endif
+	pf->n_released++;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_prefetchStop(struct riff_prefetch *pf){
+	if(pf == NULL)
+		return;
+#ifdef RIFF_POSIX
+	if(pf->threaded){
+		pthread_mutex_lock(&pf->mutex);
+		pf->stop = 1;
+		pthread_cond_broadcast(&pf->cond);
+		pthread_mutex_unlock(&pf->mutex);
+		pthread_join(pf->th, NULL);
+		pthread_cond_destroy(&pf->cond);
+		pthread_mutex_destroy(&pf->mutex);
+	}
+#endif
+	free(pf->buf);
+	free(pf->size);
+	free(pf);
+}
+
+
+
+//** probing **
+
+
+/*****************************************************************************/
+//description: see header file
+int riff_probe_mem(const void *ptr, size_t size, size_t file_size, struct riff_probeSummary *s){
+	const unsigned char *p = (const unsigned char*)ptr;
+	memset(s, 0, sizeof(struct riff_probeSummary));
+	s->size = size;
+	s->file_size = file_size;
+	
+	if(size < RIFF_HEADER_SIZE){
+		s->err = RIFF_ERROR_EOF;
+		return s->err;
+	}
+	memcpy(s->h_id, p, 4);
+	memcpy(s->h_type, p + 8, 4);
+	int be = riff_magicOrder(p);
+	s->be = (be > 0);
+	s->h_size = riff_conv32(p + 4, s->be);
+	if(be < 0  ||  !riff_checkID(p + 8)){
+		s->err = RIFF_ERROR_ILLID;
+		return s->err;
+	}
+	
+	//known file size (prefix is the whole file) must hold the segment
+	size_t listend = RIFF_CHUNK_DATA_OFFSET + s->h_size;
+	if(s->file_size > 0  &&  listend > s->file_size){
+		s->err = RIFF_ERROR_EOF;
+		s->err_pos = 0;
+	}
+	
+	//walk top level chunk headers inside the prefix
+	size_t pos = RIFF_HEADER_SIZE;
+	while(listend >= pos + RIFF_CHUNK_DATA_OFFSET){
+		if(size < pos + RIFF_CHUNK_DATA_OFFSET)
+			return s->err;  //rest is beyond prefix
+		size_t c_size = riff_conv32(p + pos + 4, s->be);
+		if(!riff_checkID(p + pos)){
+			s->err = RIFF_ERROR_ILLID;
+			s->err_pos = pos;
+			return s->err;
+		}
+		//pad byte included like in riff_readChunkHeader()
+		if(pos + RIFF_CHUNK_DATA_OFFSET + c_size + (c_size & 0x1) > listend){
+			s->err = RIFF_ERROR_ICSIZE;
+			s->err_pos = pos;
+			return s->err;
+		}
+		
+		if(s->n < RIFF_PROBE_CHUNKS){
+			struct riff_levelStackE *e = s->c + s->n;
+			e->c_pos_start = pos;
+			memcpy(e->c_id, p + pos, 4);
+			e->c_size = c_size;
+			if(riff_isListID(p + pos)  &&  size >= pos + RIFF_HEADER_SIZE)
+				memcpy(e->c_type, p + pos + RIFF_CHUNK_DATA_OFFSET, 4);
+		}
+		s->n++;
+		pos += RIFF_CHUNK_DATA_OFFSET + c_size + (c_size & 0x1);
+	}
+	
+	s->complete = 1;
+	if(listend > pos  &&  s->err == RIFF_ERROR_NONE){
+		//excess bytes at end of segment, not critical
+		s->err = RIFF_ERROR_EXDAT;
+		s->err_pos = pos;
+	}
+	return s->err;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_probe_path(const char *path, size_t budget, struct riff_probeSummary *s){
+	if(budget == 0)
+		budget = RIFF_PROBE_BUDGET;
+	
+	FILE *f = fopen(path, "rb");
+	memset(s, 0, sizeof(struct riff_probeSummary));
+	if(f == NULL){
+		s->err = RIFF_ERROR_ACCESS;
+		return s->err;
+	}
+	unsigned char *buf = malloc(budget);
+	if(buf == NULL){
+		fclose(f);
+		s->err = RIFF_ERROR_ACCESS;
+		return s->err;
+	}
+	
+	//single read, a shorter prefix is the whole file
+	size_t n = fread(buf, 1, budget, f);
+	int eof = (n < budget  &&  !ferror(f));
+	fclose(f);
+	
+	int r = riff_probe_mem(buf, n, eof ? n : 0, s);
+	free(buf);
+	return r;
+}
+
+
+
+//** virtual files **
+
+
+//kinds of extents
+#define RIFF_EXT_HDR 0  //generated bytes (headers, pad bytes), "pos" is offset in header buffer
+#define RIFF_EXT_MEM 1  //memory of the user
+#define RIFF_EXT_SRC 2  //range of a source handle
+
+//contiguous range of a virtual file
+struct riff_extent {
+	size_t vpos;        //position in virtual file
+	size_t len;
+	int kind;
+	riff_handle *src;   //source of RIFF_EXT_SRC
+	const char *mem;    //memory of RIFF_EXT_MEM
+	size_t pos;         //position in source stream or header buffer
+};
+
+//open chunk of riff_virtual
+struct riff_virtualLevel {
+	size_t hdr;         //offset of chunk header in header buffer
+	size_t vpos;        //position of chunk header in virtual file
+	int leaf;           //1: data chunk, 0: list
+};
+
+//virtual RIFF file, see riff_virtualCreate()
+struct riff_virtual {
+	int be;
+	unsigned char *hdr;        //generated bytes
+	size_t n_hdr;
+	size_t a_hdr;
+	struct riff_extent *e;     //extents in file order
+	size_t n;
+	size_t a;
+	size_t size;               //current size of virtual file
+	int level;                 //number of open chunks, level 0 is the RIFF header
+	struct riff_virtualLevel ls[RIFF_CURSOR_LEVELS + 2];
+	int finished;              //1 once the RIFF header is closed by riff_virtualFinish(), no more changes
+};
+
+/*****************************************************************************/
+//append extent, merged with the last one if contiguous
+int riff_virtualExtent(struct riff_virtual *v, int kind, riff_handle *src, const char *mem, size_t pos, size_t len){
+	struct riff_extent *l = v->n ? v->e + v->n - 1 : NULL;
+	if(len == 0)
+		return RIFF_ERROR_NONE;
+	
+	int merge = (l != NULL  &&  l->kind == kind);
+	if(merge  &&  kind == RIFF_EXT_MEM)
+		merge = (l->mem + l->len == mem);
+	else if(merge)
+		merge = (l->src == src  &&  l->pos + l->len == pos);
+	if(merge){
+		l->len += len;
+		v->size += len;
+		return RIFF_ERROR_NONE;
+	}
+	if(v->n == v->a){
+		size_t a = v->a ? v->a * 2 : RIFF_LEVEL_ALLOC;
+		struct riff_extent *enew = realloc(v->e, a * sizeof(struct riff_extent));
+		if(enew == NULL)
+			return RIFF_ERROR_ACCESS;
+		v->e = enew;
+		v->a = a;
+	}
+	l = v->e + v->n++;
+	l->vpos = v->size;
+	l->len = len;
+	l->kind = kind;
+	l->src = src;
+	l->mem = mem;
+	l->pos = pos;
+	v->size += len;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//append generated bytes
+int riff_virtualBytes(struct riff_virtual *v, const void *ptr, size_t len){
+	if(v->n_hdr + len > v->a_hdr){
+		size_t a = v->a_hdr ? v->a_hdr * 2 : 256;
+		while(a < v->n_hdr + len)
+			a *= 2;
+		unsigned char *hnew = realloc(v->hdr, a);
+		if(hnew == NULL)
+			return RIFF_ERROR_ACCESS;
+		v->hdr = hnew;
+		v->a_hdr = a;
+	}
+	memcpy(v->hdr + v->n_hdr, ptr, len);
+	v->n_hdr += len;
+	return riff_virtualExtent(v, RIFF_EXT_HDR, NULL, NULL, v->n_hdr - len, len);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_virtualBegin(struct riff_virtual *v, const char *id, const char *type){
+	if(v->finished)
+		return RIFF_ERROR_ACCESS;
+	if(v->level > 0  &&  v->ls[v->level - 1].leaf)
+		return RIFF_ERROR_ILLID;  //no sub chunks in data chunk
+	if(v->level == RIFF_CURSOR_LEVELS + 2)
+		return RIFF_ERROR_LEVEL;
+	if(!riff_checkID((const unsigned char*)id)  ||  (type != NULL  &&  !riff_checkID((const unsigned char*)type)))
+		return RIFF_ERROR_ILLID;
+	
+	unsigned char h[RIFF_HEADER_SIZE];
+	memcpy(h, id, 4);
+	memset(h + 4, 0, 4);  //size is set by riff_virtualEnd()
+	if(type != NULL)
+		memcpy(h + RIFF_CHUNK_DATA_OFFSET, type, 4);
+	
+	struct riff_virtualLevel *ls = v->ls + v->level;
+	ls->hdr = v->n_hdr;
+	ls->vpos = v->size;
+	ls->leaf = (type == NULL);
+	int r = riff_virtualBytes(v, h, (type != NULL) ? RIFF_HEADER_SIZE : RIFF_CHUNK_DATA_OFFSET);
+	if(r == RIFF_ERROR_NONE)
+		v->level++;
+	return r;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_virtualFree(struct riff_virtual *v){
+	if(v == NULL)
+		return;
+	free(v->hdr);
+	free(v->e);
+	free(v);
+}
+
+/*****************************************************************************/
+//description: see header file
+struct riff_virtual *riff_virtualCreate(const char *h_id, const char *h_type){
+	if(h_id == NULL  ||  h_type == NULL)
+		return NULL;
+	int be = riff_magicOrder(h_id);
+	if(be < 0)
+		return NULL;
+	struct riff_virtual *v = calloc(1, sizeof(struct riff_virtual));
+	if(v == NULL)
+		return NULL;
+	v->be = be;
+	if(riff_virtualBegin(v, h_id, h_type) != RIFF_ERROR_NONE){
+		riff_virtualFree(v);
+		return NULL;
+	}
+	return v;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_virtualData(struct riff_virtual *v, riff_handle *src, size_t pos, size_t len){
+	if(v->finished)
+		return RIFF_ERROR_ACCESS;
+	if(v->level == 0  ||  !v->ls[v->level - 1].leaf)
+		return RIFF_ERROR_ILLID;
+	if(src == NULL  ||  src->fp_read == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	return riff_virtualExtent(v, RIFF_EXT_SRC, src, NULL, pos, len);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_virtualDataMem(struct riff_virtual *v, const void *ptr, size_t len){
+	if(v->finished)
+		return RIFF_ERROR_ACCESS;
+	if(v->level == 0  ||  !v->ls[v->level - 1].leaf)
+		return RIFF_ERROR_ILLID;
+	return riff_virtualExtent(v, RIFF_EXT_MEM, NULL, (const char*)ptr, 0, len);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_virtualEnd(struct riff_virtual *v){
+	if(v->finished)
+		return RIFF_ERROR_ACCESS;
+	//the RIFF header is closed by riff_virtualFinish() only
+	if(v->level <= 1)
+		return RIFF_ERROR_LEVEL;
+	struct riff_virtualLevel *ls = v->ls + v->level - 1;
+	size_t size = v->size - ls->vpos - RIFF_CHUNK_DATA_OFFSET;
+	if(size > 0xFFFFFFFF)
+		return RIFF_ERROR_ICSIZE;
+	riff_put32(v->hdr + ls->hdr + 4, size, v->be);
+	//sub chunks start at even positions
+	if(size & 0x1){
+		int r = riff_virtualBytes(v, "", 1);
+		if(r != RIFF_ERROR_NONE)
+			return r;
+	}
+	v->level--;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//read from virtual file at position, returns number of bytes read
+size_t riff_virtualPread(struct riff_virtual *v, void *ptr, size_t size, size_t pos){
+	size_t n = 0;
+	if(v->n == 0  ||  pos >= v->size)
+		return 0;
+	
+	//find extent containing pos
+	size_t lo = 0;
+	size_t hi = v->n - 1;
+	while(lo < hi){
+		size_t mid = (lo + hi + 1) / 2;
+		if(v->e[mid].vpos <= pos)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	
+	for(; lo < v->n  &&  n < size; lo++){
+		struct riff_extent *e = v->e + lo;
+		size_t offs = pos + n - e->vpos;
+		size_t len = e->len - offs;
+		if(len > size - n)
+			len = size - n;
+		char *to = (char*)ptr + n;
+		
+		if(e->kind == RIFF_EXT_HDR)
+			memcpy(to, v->hdr + e->pos + offs, len);
+		else if(e->kind == RIFF_EXT_MEM)
+			memcpy(to, e->mem + offs, len);
+		else {
+			size_t r = riff_pread(e->src, to, len, e->pos + offs);
+			if(e->src->fp_readv == NULL)
+				e->src->fp_seek(e->src->fh, e->src->pos);
+			n += r;
+			if(r < len)
+				break;
+			continue;
+		}
+		n += len;
+	}
+	return n;
+}
+
+/*****************************************************************************/
+//close RIFF header, all other chunks must be closed; may be called again
+int riff_virtualFinish(struct riff_virtual *v){
+	if(v->level != 1)
+		return RIFF_ERROR_LEVEL;
+	struct riff_virtualLevel *ls = v->ls;
+	if(v->size - RIFF_CHUNK_DATA_OFFSET > 0xFFFFFFFF)
+		return RIFF_ERROR_ICSIZE;
+	riff_put32(v->hdr + ls->hdr + 4, v->size - RIFF_CHUNK_DATA_OFFSET, v->be);
+	v->finished = 1;
+	return RIFF_ERROR_NONE;
+}
+
+//state of virtual file backend
+struct riff_virtualStream {
+	struct riff_virtual *v;
+	size_t pos;
+};
+
+/*****************************************************************************/
+size_t read_virtual(void *fh, void *ptr, size_t size){
+	struct riff_virtualStream *s = (struct riff_virtualStream*)fh;
+	size_t n = riff_virtualPread(s->v, ptr, size, s->pos);
+	s->pos += n;
+	return n;
+}
+
+/*****************************************************************************/
+size_t seek_virtual(void *fh, size_t pos){
+	((struct riff_virtualStream*)fh)->pos = pos;
+	return pos;
+}
+
+/*****************************************************************************/
+size_t readv_virtual(void *fh, const struct riff_iovec *iov, int iovcnt, size_t pos){
+	struct riff_virtualStream *s = (struct riff_virtualStream*)fh;
+	size_t n = 0;
+	int i;
+	for(i = 0; i < iovcnt; i++){
+		size_t r = riff_virtualPread(s->v, iov[i].base, iov[i].len, pos + n);
+		n += r;
+		if(r < iov[i].len)
+			break;
+	}
+	return n;
+}
+
+/*****************************************************************************/
+size_t size_virtual(void *fh){
+	return ((struct riff_virtualStream*)fh)->v->size;
+}
+
+/*****************************************************************************/
+void free_virtual(void *fh){
+	free(fh);
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_open_virtual(riff_handle *rh, struct riff_virtual *v){
+	if(rh == NULL  ||  v == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	int r = riff_virtualFinish(v);
+	if(r != RIFF_ERROR_NONE)
+		return r;
+	
+	struct riff_virtualStream *s = malloc(sizeof(struct riff_virtualStream));
+	if(s == NULL)
+		return RIFF_ERROR_ACCESS;
+	s->v = v;
+	s->pos = 0;
+	
+	rh->fh = s;
+	rh->size = v->size;
+	
+	rh->fp_read = &read_virtual;
+	rh->fp_seek = &seek_virtual;
+	rh->fp_readv = &readv_virtual;
+	rh->fp_size = &size_virtual;
+	rh->fp_free = &free_virtual;
+	
+	return riff_readHeader(rh);
+}
+
+/*****************************************************************************/
+//description: see header file
+size_t riff_virtualSendTo(struct riff_virtual *v, int out_fd, size_t offset, size_t len){
+	if(riff_virtualFinish(v) != RIFF_ERROR_NONE  ||  offset >= v->size)
+		return 0;
+	if(len > v->size - offset)
+		len = v->size - offset;
+	
+	size_t n = 0;
+	size_t i;
+	for(i = 0; i < v->n  &&  n < len; i++){
+		struct riff_extent *e = v->e + i;
+		if(e->vpos + e->len <= offset + n)
+			continue;
+		size_t offs = offset + n - e->vpos;
+		size_t size = e->len - offs;
+		if(size > len - n)
+			size = len - n;
+		
+		size_t w;
+		if(e->kind == RIFF_EXT_HDR)
+			w = riff_writeAll(out_fd, (const char*)v->hdr + e->pos + offs, size);
+		else if(e->kind == RIFF_EXT_MEM)
+			w = riff_writeAll(out_fd, e->mem + offs, size);
+		else
+			w = riff_copyRange(e->src, out_fd, e->pos + offs, size);  //kernel space if possible
+		n += w;
+		if(w < size)
+			break;
+	}
+	return n;
+}
+
 /*****************************************************************************/
 //description: see header file
 const char *riff_errorToString(int e){
@@ -566,10 +2811,13 @@ const char *riff_errorToString(int e){
 		case RIFF_ERROR_INVALID_HANDLE:
 			return riff_es[RIFF_ERROR_INVALID_HANDLE];
 			break;
+		case RIFF_ERROR_LEVEL:
+			return riff_es[RIFF_ERROR_LEVEL];
+			break;
 		
 		
 		default:
-			return  riff_es[9];
+			return  riff_es[10];
 			break;
 	}
 }
@@ -34,7 +34,12 @@ If the current junk contains a list of sub level chunks:
  Call riff_levelParent() to leave the sub list without changing the file position
 Read members of the riff_handle to get all info about current file position, current chunk, etc.
 
-May not work for RIFF files larger than 2GB.
+Big endian files with "RIFX" header are supported too, the byte order is picked when opening (member "be")
+ Integers in chunk data are not converted, except by the decoders in "riff_decode.h"
+
+Files larger than 4GB (e.g. OpenDML AVI with "AVIX" extensions) consist of several consecutive "RIFF" segments at file level
+ riff_seekNextChunk() stops at the end of the current segment, call riff_seekNextSegment() to continue with the next one
+ Positions are stored in size_t, so 32 bit systems are limited to 4GB.
 */
 
 
@@ -49,6 +54,14 @@ May not work for RIFF files larger than 2GB.
 #define RIFF_CHUNK_DATA_OFFSET 8  //offset from start of chunk, size of chunk ID + chunk size field.
 
 
+//platforms providing POSIX I/O (file descriptors, preadv(), ...), may be defined by the build too
+#ifndef RIFF_POSIX
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define RIFF_POSIX
+#endif
+#endif
+
+
 //Error codes (pass to riff_errorToString()), value mapping may change in the future
 //non critical
 #define RIFF_ERROR_NONE   0  //no error
@@ -65,6 +78,7 @@ May not work for RIFF files larger than 2GB.
 #define RIFF_ERROR_ACCESS    7  //access error, indicating that the file is not accessible (permissions, invalid file handle, etc.)
 
 #define RIFF_ERROR_INVALID_HANDLE 8  //riff_handle is not set up or is NULL
+#define RIFF_ERROR_LEVEL     9  //list nesting exceeds RIFF_CURSOR_LEVELS, a riff_cursor can't enter the sub list
 
 
 /*
@@ -81,6 +95,13 @@ typedef struct riff_header
 
 
 
+//buffer descriptor for vectored reads, see riff_readvInChunk()
+struct riff_iovec {
+	void *base;  //start of buffer
+	size_t len;  //number of bytes to read into buffer
+};
+
+
 //level stack entry
 //needed to retrace from sub level (list) chunk
 //header info of parent
@@ -92,15 +113,46 @@ struct riff_levelStackE {
 };
 
 
+//report entry of riff_validateParallel(), one per top level chunk
+struct riff_validateEntry {
+	size_t c_pos_start;  //absolute chunk position in file stream, start of chunk header
+	char c_id[5];        //ID of chunk
+	size_t c_size;       //chunk size without chunk header
+	char c_type[5];      //type ID if chunk contains sub chunks, else empty
+	size_t n_chunks;     //number of chunks in subtree, including this one
+	int err;             //first error found in subtree
+	size_t err_pos;      //position of chunk header where the error occured
+	int seg;             //index of RIFF segment containing the chunk
+};
+
+//report of riff_validateParallel()
+struct riff_validateReport {
+	struct riff_validateEntry *e;  //top level chunks in file order
+	size_t n;                      //number of entries
+	int n_seg;                     //number of RIFF segments in file
+	int err;                       //first error in file order
+	size_t err_pos;                //position of first error
+};
+
+
+//options of riff_compact()
+struct riff_compactPolicy {
+	size_t align;  //0: drop all filler chunks ("JUNK", "PAD "); else shrink them so the position following them stays aligned to this value (even)
+};
+
+
 //RIFF handle structure
 //- Members are public and intended for read access (to avoid a plethora of get-functions)
 //  Be careful with the stack, check "ls_size" first
 typedef struct riff_handle {
 	//RIFF file header info, available once the file is opened (could have been put)
-	char h_id[5];      //"RIFF" + terminator
+	char h_id[5];      //"RIFF" (or "RIFX") + terminator
 	size_t h_size;     //size value given in header (h_size + 8 == file_size)
 	char h_type[5];    //type of file FOURCC + terminator
 	size_t pos_start;  //start pos of RIFF file
+	size_t h_pos_start; //start pos of current RIFF segment (header), equals pos_start in the first segment
+	int h_seg;          //index of current RIFF segment, 0 for the first
+	int be;             //1 if size values are big endian ("RIFX"), picked when opening
 
 	size_t size;      //total size of RIFF file, 0 means unspecified
 	size_t pos;       //current position in stream
@@ -116,7 +168,12 @@ typedef struct riff_handle {
 	size_t ls_size;     //size of stack in num. elements, stack extends automatically if needed
 	int ls_level;       //current level, starts at 0
 	
-	void *fh;  //file handle or memory address, only accessed by user FP functions
+	void *fh;  //file handle or state of memory backend, only accessed by user FP functions
+	
+	//follow mode for files that are still being written, to be assigned before calling riff_open_...() (see riff_followStart())
+	//size checks are skipped, chunks and lists with placeholder size and the last RIFF segment reach up to the end of available data ("size")
+	//placeholder sizes: 0xFFFFFFFF, 0 for lists and for the chunk at the end of available data (the one being written)
+	int follow;
 	
 	
 	
@@ -129,6 +186,27 @@ typedef struct riff_handle {
 	//seek position relative to start pos; required
 	size_t (*fp_seek)(void *fh, size_t pos);
 	
+	//read bytes into several buffers starting at given position (like fp_seek() + fp_read()), return number of bytes read; optional
+	//must not change the stream position used by fp_read()
+	//if NULL, fp_read() is called for each buffer instead
+	size_t (*fp_readv)(void *fh, const struct riff_iovec *iov, int iovcnt, size_t pos);
+	
+	//return file descriptor of the source and in "offs" the descriptor's file offset of stream position 0, -1 if there is none; optional
+	//used for copying in kernel space, see riff_copyChunkTo()
+	int (*fp_fd)(void *fh, size_t *offs);
+	
+	//return size of source (file size), 0 if unknown; optional
+	//used in follow mode, see riff_followPoll()
+	size_t (*fp_size)(void *fh);
+	
+	//free state allocated by the open-function (not the user's file or memory); optional
+	//called by riff_handleFree()
+	void (*fp_free)(void *fh);
+	
+	//chunk header parsers for the file's byte order, set when opening
+	int (*fp_readChunkHeader)(struct riff_handle *rh);
+	int (*fp_preadChunkHeader)(struct riff_handle *rh, size_t pos, size_t listend, struct riff_levelStackE *e);
+	
 	//print error; optional;
 	//allocate function maps it to vfprintf(stderr, ...) by default; set to NULL after allocation to disable any printing
 	//to be assigned before calling riff_open_...()
@@ -139,6 +217,67 @@ typedef struct riff_handle {
 
 
 
+#define RIFF_CURSOR_LEVELS 8  //max. number of list levels a cursor can enter
+
+
+//new data reported by riff_followPoll()
+struct riff_followRange {
+	size_t c_pos_start;  //start of chunk header
+	char c_id[5];        //ID of chunk
+	char ls_type[5];     //type ID of containing list (form type at level 0)
+	int level;           //list level of chunk
+	size_t from;         //new data of chunk from this position ...
+	size_t to;           //... up to this position (exclusive)
+	int complete;        //1 if the end of the chunk is reached
+};
+
+
+#define RIFF_PROBE_CHUNKS 16  //max. number of top level chunks listed by riff_probe_...()
+
+//result of riff_probe_...()
+struct riff_probeSummary {
+	char h_id[5];        //"RIFF" or "RIFX" + terminator
+	size_t h_size;       //size value given in header
+	char h_type[5];      //form type + terminator
+	int be;              //1 if size values are big endian ("RIFX")
+	size_t size;         //size of examined prefix
+	size_t file_size;    //size of file if the prefix covers it, else 0 (unknown)
+	int n;               //number of top level chunk headers found in the prefix, the first RIFF_PROBE_CHUNKS are listed in "c"
+	struct riff_levelStackE c[RIFF_PROBE_CHUNKS];  //top level chunks, c_type is empty if not a "LIST" or beyond the prefix
+	int complete;        //1 if all top level chunk headers of the first RIFF segment are in the prefix
+	int err;             //RIFF_ERROR_NONE or RIFF_ERROR_EXDAT if the layout is plausible, else the first problem found
+	size_t err_pos;      //position of the problem
+};
+
+
+//block of chunk data returned by riff_prefetchNext()
+struct riff_prefetchBlock {
+	const void *data;
+	size_t size;   //number of bytes, block size except for the last block
+	size_t c_pos;  //offset of the first byte in chunk data
+};
+
+
+//Cursor, a position in a file that is independent of the handle's position
+//- Small and without allocated memory, copy by assignment to clone a position
+//- Uses only positioned reads (fp_readv) of the handle, so several cursors can be used concurrently by different threads
+//  (if the handle has no fp_readv, reads go through fp_seek()/fp_read() and are not thread safe)
+//- Members have the same meaning as in riff_handle, read access only
+typedef struct riff_cursor {
+	riff_handle *rh;     //shared handle providing the data, the handle itself can still be used for navigation
+	size_t h_pos_start;  //start pos of current RIFF segment
+	size_t h_size;       //size of current RIFF segment
+	size_t pos;          //current position in stream
+	size_t c_pos_start;  //start pos of current chunk
+	size_t c_pos;        //position in current chunk data
+	char c_id[5];        //id of current chunk + terminator
+	size_t c_size;       //size of current chunk data
+	char pad;            //1 if c_size is odd
+	int ls_level;        //current level, starts at 0
+	struct riff_levelStackE ls[RIFF_CURSOR_LEVELS]; //level stack, parent chunk: ls[ls_level-1]
+} riff_cursor;
+
+
 //Allocate, initialize and return handle;
 riff_handle *riff_handleAllocate();
 
@@ -149,12 +288,20 @@ void riff_handleFree(riff_handle *rh);
 
 //functions to parse a riff file
 size_t riff_readInChunk(riff_handle *rh, void *to, size_t size); //read in current chunk, returns RIFF_ERROR_EOC if end of chunk is reached
+size_t riff_readvInChunk(riff_handle *rh, const struct riff_iovec *iov, int iovcnt); //like riff_readInChunk(), but fill buffers in order (scatter read), returns total number of bytes read
+size_t riff_readAt(riff_handle *rh, void *to, size_t size, size_t pos); //read at stream position "pos" (e.g. data of a chunk found before) without changing the handle's position, returns number of bytes read
+//copy data of current chunk from chunk offset "offset" to file descriptor (file, pipe or socket), returns number of bytes written
+//len is limited to the end of chunk; the position in the handle is not changed, the position of out_fd moves like with write()
+//copies in kernel space (copy_file_range(), sendfile()) with RIFF_POSIX on Linux if the source provides a file descriptor (fp_fd), else in a buffered loop
+//without POSIX or Windows there are no file descriptors, nothing is written and 0 is returned
+size_t riff_copyChunkTo(riff_handle *rh, int out_fd, size_t offset, size_t len);
 int riff_seekInChunk(riff_handle *rh, size_t c_pos);      //seek in current chunk, returns RIFF_ERROR_EOC if end of chunk is reached, pos 0 is first byte after chunk size (chunk offset 8)
 
 int riff_seekNextChunk(struct riff_handle *rh);       //seek to start of next chunk within current level, ID and size is read automatically, return
 //int riff_seekNextChunkID(struct riff_handle *rh, char *id);  //find and go to next chunk with id (4 byte) in current level, fails if not found - position is invalid then -> maybe not needed, the user can do it via simple loop
+int riff_seekNextSegment(struct riff_handle *rh);     //seek to first chunk of next RIFF segment at file level (e.g. "AVIX" after "AVI "), leaves all sub levels, returns RIFF_ERROR_EOCL if there is none
 int riff_seekChunkStart(struct riff_handle *rh);      //seek back to data start of current chunk
-int riff_rewind(struct riff_handle *rh);              //seek back to very first chunk of file at level 0, the position just after opening via riff_open_...()
+int riff_rewind(struct riff_handle *rh);              //seek back to very first chunk of file at level 0 of first segment, the position just after opening via riff_open_...()
 int riff_seekLevelStart(struct riff_handle *rh);      //goto start of first data byte of first chunk in current level (seek backward)
 
 int riff_seekLevelSub(struct riff_handle *rh);        //goto sub level chunk (auto seek to start of parent chunk if not already there); "LIST" chunk typically contains a list of sub chunks
@@ -171,6 +318,76 @@ int riff_levelParent(struct riff_handle *rh);
 //file position is changed by function
 int riff_levelValidate(struct riff_handle *rh);
 
+//cursor functions, same behaviour as their handle counterparts
+//the cursor is left unchanged if an error is returned
+int riff_cursorInit(riff_cursor *cur, riff_handle *rh);             //set cursor to the current position of the handle
+size_t riff_cursorRead(riff_cursor *cur, void *to, size_t size);    //see riff_readInChunk()
+int riff_cursorSeekInChunk(riff_cursor *cur, size_t c_pos);         //see riff_seekInChunk()
+int riff_cursorNextChunk(riff_cursor *cur);                         //see riff_seekNextChunk()
+int riff_cursorNextSegment(riff_cursor *cur);                       //see riff_seekNextSegment()
+int riff_cursorLevelStart(riff_cursor *cur);                        //see riff_seekLevelStart()
+int riff_cursorLevelSub(riff_cursor *cur);                          //see riff_seekLevelSub(), returns RIFF_ERROR_EOCL for an empty list, RIFF_ERROR_LEVEL if nested too deep
+int riff_cursorLevelParent(riff_cursor *cur);                       //see riff_levelParent()
+
+//follow a file that is still being written (e.g. WAV or AVI recording), parsing only appended data on each poll
+//riff_followStart() enables follow mode of the handle (rh->follow), set it before opening to tolerate the sizes of the RIFF header and first chunk too
+//riff_followPoll() parses chunk headers from the end of the last poll up to "avail" (stream position, 0 to get the size via fp_size)
+//  and reports new data of leaf chunks in file order, up to n_max ranges per call (the rest follows with the next call), *n receives the number of ranges
+//  lists are entered automatically; a chunk with placeholder size grows until the end of file (see rh->follow),
+//  an empty chunk is only taken as growing if no data follows it yet when its header is parsed
+//  the end of a chunk whose data is reported already (empty chunk, final size written later) is reported as empty range (from == to) with "complete" set
+//  the handle's size is updated, so it can navigate to the new chunks; reads are positioned, the handle's position is not changed
+struct riff_follow *riff_followStart(struct riff_handle *rh);
+int riff_followPoll(struct riff_follow *fw, size_t avail, struct riff_followRange *out, int n_max, int *n);
+void riff_followStop(struct riff_follow *fw);
+
+//streaming reader over the current chunk, reads ahead into a ring of "depth" buffers of "block_size" bytes (0: defaults)
+//the data from the current position to the end of chunk data is read by a background thread with positioned reads (fp_readv),
+//without fp_readv or threads, riff_prefetchNext() reads each block synchronously
+//the handle's position is not changed, it can be used for navigation while prefetching if it has fp_readv
+//riff_prefetchNext() returns the next block in file order, waiting for it if necessary, RIFF_ERROR_EOC at end of chunk,
+//  RIFF_ERROR_EOF if the data ends early; RIFF_ERROR_ACCESS if all buffers are held by the caller
+//riff_prefetchRelease() returns the oldest block handed out, its buffer is refilled
+struct riff_prefetch *riff_prefetchStart(struct riff_handle *rh, int depth, size_t block_size);
+int riff_prefetchNext(struct riff_prefetch *pf, struct riff_prefetchBlock *b);
+void riff_prefetchRelease(struct riff_prefetch *pf);
+void riff_prefetchStop(struct riff_prefetch *pf);
+
+//validate the whole file, all RIFF segments and chunk levels, without changing the file position
+//top level chunks are read first, then the sub lists of the top level LIST chunks are validated concurrently by "nthreads" threads
+//(the calling thread and nthreads - 1 started threads)
+//requires positioned reads (fp_readv) for more than one thread, else runs in the calling thread
+//the report lists all top level chunks in file order, free it with riff_validateReportFree()
+//returns the first error in file order (same as rep->err)
+int riff_validateParallel(struct riff_handle *rh, int nthreads, struct riff_validateReport *rep);
+void riff_validateReportFree(struct riff_validateReport *rep);
+
+//virtual RIFF file, built from chunks whose data references ranges of other sources (handles) or memory, nothing is copied
+//riff_virtualCreate() starts the file with header ID ("RIFF" or "RIFX") and form type (both required), returns NULL on failure
+//riff_virtualBegin() starts a chunk in the current list, "type" != NULL starts a "LIST" (or nested RIFF) with sub chunks, else a data chunk
+//riff_virtualData() appends "len" bytes at stream position "pos" of "src" to the data of the current chunk, riff_virtualDataMem() appends memory
+//  sources and memory must stay valid while the virtual file is used; the position of a source without fp_readv is restored after each read
+//riff_virtualEnd() closes the current chunk, its size is computed and a pad byte is added if needed; the RIFF header itself is closed on use, not by riff_virtualEnd()
+//once all chunks except the RIFF header are closed, the file can be read via riff_open_virtual() or sent to a file descriptor,
+//  further changes are rejected then with RIFF_ERROR_ACCESS
+//functions return error code, RIFF_ERROR_LEVEL if chunks are not closed or nested too deep (RIFF_CURSOR_LEVELS)
+struct riff_virtual *riff_virtualCreate(const char *h_id, const char *h_type);
+int riff_virtualBegin(struct riff_virtual *v, const char *id, const char *type);
+int riff_virtualData(struct riff_virtual *v, struct riff_handle *src, size_t pos, size_t len);
+int riff_virtualDataMem(struct riff_virtual *v, const void *ptr, size_t len);
+int riff_virtualEnd(struct riff_virtual *v);
+//write "len" bytes of the virtual file from "offset" to file descriptor, returns number of bytes written
+//ranges of sources are copied in kernel space per extent if possible (see riff_copyChunkTo()), without file descriptors 0 is returned
+size_t riff_virtualSendTo(struct riff_virtual *v, int out_fd, size_t offset, size_t len);
+void riff_virtualFree(struct riff_virtual *v);
+
+//write a copy of the file to "dst" without filler chunks ("JUNK", "PAD ") and excess bytes at the end of lists, all RIFF and LIST sizes are recomputed
+//chunk headers are walked once to plan the output, then the data is streamed in one sequential pass, written in large blocks
+//policy may be NULL to drop all filler chunks
+//absolute file offsets stored inside chunk data (e.g. OpenDML AVI indexes) are not adjusted
+//the file position of rh is changed
+int riff_compact(struct riff_handle *rh, FILE *dst, const struct riff_compactPolicy *policy);
+
 //return string to error code
 //the current position (h->pos) tells you where in the file the problem occured
 const char *riff_errorToString(int e);
@@ -202,6 +419,15 @@ const char *riff_errorToString(int e);
 //to be called from user IO functions
 int riff_readHeader(riff_handle *rh);
 
+//pass pointer to 32 bit LE value and convert, return in native byte order
+unsigned int convUInt32LE(void *p);
+
+//pass pointer to 32 bit BE value and convert, return in native byte order
+unsigned int convUInt32BE(void *p);
+
+//convert 32 bit value in file byte order (rh->be), return in native byte order
+unsigned int riff_conv32(const void *p, int be);
+
 
 
 
@@ -221,6 +447,27 @@ int riff_open_file(riff_handle *h, FILE *f, size_t size);
 int riff_open_mem(riff_handle *h, void *memptr, size_t size);
 
 
+//create and return initialized RIFF handle, reading a RIFF file nested in the current chunk of another handle
+//no data is copied, reads are passed to the parent's functions and limited to the chunk ("window")
+//if the current chunk of the parent has ID "RIFF", the window starts at its chunk header, else at its chunk data
+//positions of the new handle are relative to the window start
+//the parent must not be freed before the new handle, it can still be used (positioned reads don't change its file position)
+int riff_open_subchunk(riff_handle *h, riff_handle *parent);
+
+
+//examine the start of a file without allocating a handle, for fast classification of many files
+//header, form type and the top level chunk headers in the prefix are reported and checked for plausibility
+//riff_probe_mem() examines "size" bytes at ptr (a prefix of the file), pass file_size if known, else 0
+//riff_probe_path() reads a prefix of up to "budget" bytes (0: 64KB) with a single read
+//returns error code, same as s->err
+int riff_probe_mem(const void *ptr, size_t size, size_t file_size, struct riff_probeSummary *s);
+int riff_probe_path(const char *path, size_t budget, struct riff_probeSummary *s);
+
+
+//create and return initialized RIFF handle reading a virtual file (see riff_virtualCreate()), the virtual file must not be freed before the handle
+int riff_open_virtual(riff_handle *h, struct riff_virtual *v);
+
+
 //user open - must handle "riff_handle" allocation and setup
 // e.g. for file access via network socket
 // see and use "riff_open_file()" definition as template
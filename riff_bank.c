@@ -0,0 +1,814 @@
+// sound banks, see "riff_bank.h"
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "riff.h"
+#include "riff_decode.h"
+#include "riff_bank.h"
+
+#ifdef RIFF_POSIX
+#include <pthread.h>
+#endif
+
+
+#define RIFF_BANK_ALLOC 64  //number of table entries allocated per step, doubled when growing
+
+
+
+// **** record layouts ****
+
+//SF2 sample header, converted to struct riff_bankSample after loading
+struct riff_sf2Shdr {
+	char name[21];
+	uint32_t start;
+	uint32_t end;
+	uint32_t start_loop;
+	uint32_t end_loop;
+	uint32_t sample_rate;
+	uint8_t original_pitch;
+	int8_t pitch_correction;
+	uint16_t link;
+	uint16_t type;
+};
+
+//DLS instrument header
+struct riff_dlsInsh {
+	uint32_t n_regions;
+	uint32_t bank;
+	uint32_t program;
+};
+
+//DLS wave sample info, only the first loop is used
+struct riff_dlsWsmp {
+	uint32_t size;             //size of structure, loops follow
+	uint16_t unity_note;
+	int16_t fine_tune;
+	uint32_t n_loops;
+	uint32_t loop_start;
+	uint32_t loop_length;
+};
+
+//DLS wave link
+struct riff_dlsWlnk {
+	uint16_t options;
+	uint16_t phase_group;
+	uint32_t channel;
+	uint32_t table_index;
+};
+
+
+//names have 20 chars in the file and a terminator in the native struct
+#define RIFF_NAME_FIELD(type)  { 0, offsetof(type, name), 20, 0 }
+
+static const struct riff_field riff_fields_phdr[] = {
+	RIFF_NAME_FIELD(struct riff_sf2Preset),
+	RIFF_FIELD(20, struct riff_sf2Preset, preset, 1),
+	RIFF_FIELD(22, struct riff_sf2Preset, bank, 1),
+	RIFF_FIELD(24, struct riff_sf2Preset, bag, 1),
+	RIFF_FIELD(26, struct riff_sf2Preset, library, 1),
+	RIFF_FIELD(30, struct riff_sf2Preset, genre, 1),
+	RIFF_FIELD(34, struct riff_sf2Preset, morphology, 1),
+};
+
+static const struct riff_field riff_fields_inst[] = {
+	RIFF_NAME_FIELD(struct riff_sf2Inst),
+	RIFF_FIELD(20, struct riff_sf2Inst, bag, 1),
+};
+
+static const struct riff_field riff_fields_bag[] = {
+	RIFF_FIELD( 0, struct riff_sf2Bag, gen, 1),
+	RIFF_FIELD( 2, struct riff_sf2Bag, mod, 1),
+};
+
+static const struct riff_field riff_fields_mod[] = {
+	RIFF_FIELD( 0, struct riff_sf2Mod, src, 1),
+	RIFF_FIELD( 2, struct riff_sf2Mod, dest, 1),
+	RIFF_FIELD( 4, struct riff_sf2Mod, amount, 1),
+	RIFF_FIELD( 6, struct riff_sf2Mod, amount_src, 1),
+	RIFF_FIELD( 8, struct riff_sf2Mod, transform, 1),
+};
+
+static const struct riff_field riff_fields_gen[] = {
+	RIFF_FIELD( 0, struct riff_sf2Gen, oper, 1),
+	RIFF_FIELD( 2, struct riff_sf2Gen, amount, 1),
+};
+
+static const struct riff_field riff_fields_shdr[] = {
+	RIFF_NAME_FIELD(struct riff_sf2Shdr),
+	RIFF_FIELD(20, struct riff_sf2Shdr, start, 1),
+	RIFF_FIELD(24, struct riff_sf2Shdr, end, 1),
+	RIFF_FIELD(28, struct riff_sf2Shdr, start_loop, 1),
+	RIFF_FIELD(32, struct riff_sf2Shdr, end_loop, 1),
+	RIFF_FIELD(36, struct riff_sf2Shdr, sample_rate, 1),
+	RIFF_FIELD(40, struct riff_sf2Shdr, original_pitch, 0),
+	RIFF_FIELD(41, struct riff_sf2Shdr, pitch_correction, 0),
+	RIFF_FIELD(42, struct riff_sf2Shdr, link, 1),
+	RIFF_FIELD(44, struct riff_sf2Shdr, type, 1),
+};
+
+static const struct riff_field riff_fields_insh[] = {
+	RIFF_FIELD( 0, struct riff_dlsInsh, n_regions, 1),
+	RIFF_FIELD( 4, struct riff_dlsInsh, bank, 1),
+	RIFF_FIELD( 8, struct riff_dlsInsh, program, 1),
+};
+
+static const struct riff_field riff_fields_rgnh[] = {
+	RIFF_FIELD( 0, struct riff_dlsRegion, key_lo, 1),
+	RIFF_FIELD( 2, struct riff_dlsRegion, key_hi, 1),
+	RIFF_FIELD( 4, struct riff_dlsRegion, vel_lo, 1),
+	RIFF_FIELD( 6, struct riff_dlsRegion, vel_hi, 1),
+	RIFF_FIELD( 8, struct riff_dlsRegion, options, 1),
+	RIFF_FIELD(10, struct riff_dlsRegion, key_group, 1),
+};
+
+static const struct riff_field riff_fields_wsmp[] = {
+	RIFF_FIELD( 0, struct riff_dlsWsmp, size, 1),
+	RIFF_FIELD( 4, struct riff_dlsWsmp, unity_note, 1),
+	RIFF_FIELD( 6, struct riff_dlsWsmp, fine_tune, 1),
+	RIFF_FIELD(16, struct riff_dlsWsmp, n_loops, 1),
+};
+
+static const struct riff_field riff_fields_wlnk[] = {
+	RIFF_FIELD( 0, struct riff_dlsWlnk, options, 1),
+	RIFF_FIELD( 2, struct riff_dlsWlnk, phase_group, 1),
+	RIFF_FIELD( 4, struct riff_dlsWlnk, channel, 1),
+	RIFF_FIELD( 8, struct riff_dlsWlnk, table_index, 1),
+};
+
+static const struct riff_field riff_fields_conn[] = {
+	RIFF_FIELD( 0, struct riff_dlsConnection, source, 1),
+	RIFF_FIELD( 2, struct riff_dlsConnection, control, 1),
+	RIFF_FIELD( 4, struct riff_dlsConnection, destination, 1),
+	RIFF_FIELD( 6, struct riff_dlsConnection, transform, 1),
+	RIFF_FIELD( 8, struct riff_dlsConnection, scale, 1),
+};
+
+#define RIFF_N_FIELDS(f) ((int)(sizeof(f) / sizeof(f[0])))
+
+static const struct riff_layout riff_layout_phdr = {"phdr", 38, sizeof(struct riff_sf2Preset), riff_fields_phdr, RIFF_N_FIELDS(riff_fields_phdr), 0};
+static const struct riff_layout riff_layout_inst = {"inst", 22, sizeof(struct riff_sf2Inst), riff_fields_inst, RIFF_N_FIELDS(riff_fields_inst), 0};
+static const struct riff_layout riff_layout_bag = {"pbag", 4, sizeof(struct riff_sf2Bag), riff_fields_bag, RIFF_N_FIELDS(riff_fields_bag), 0};
+static const struct riff_layout riff_layout_mod = {"pmod", 10, sizeof(struct riff_sf2Mod), riff_fields_mod, RIFF_N_FIELDS(riff_fields_mod), 0};
+static const struct riff_layout riff_layout_gen = {"pgen", 4, sizeof(struct riff_sf2Gen), riff_fields_gen, RIFF_N_FIELDS(riff_fields_gen), 0};
+static const struct riff_layout riff_layout_shdr = {"shdr", 46, sizeof(struct riff_sf2Shdr), riff_fields_shdr, RIFF_N_FIELDS(riff_fields_shdr), 0};
+static const struct riff_layout riff_layout_insh = {"insh", 12, sizeof(struct riff_dlsInsh), riff_fields_insh, RIFF_N_FIELDS(riff_fields_insh), 0};
+static const struct riff_layout riff_layout_rgnh = {"rgnh", 12, sizeof(struct riff_dlsRegion), riff_fields_rgnh, RIFF_N_FIELDS(riff_fields_rgnh), 0};
+static const struct riff_layout riff_layout_wsmp = {"wsmp", 20, sizeof(struct riff_dlsWsmp), riff_fields_wsmp, RIFF_N_FIELDS(riff_fields_wsmp), 0};
+static const struct riff_layout riff_layout_wlnk = {"wlnk", 12, sizeof(struct riff_dlsWlnk), riff_fields_wlnk, RIFF_N_FIELDS(riff_fields_wlnk), 0};
+static const struct riff_layout riff_layout_conn = {"art1", 12, sizeof(struct riff_dlsConnection), riff_fields_conn, RIFF_N_FIELDS(riff_fields_conn), 0};
+
+
+//SF2 "pdta" sub chunks and the corresponding table of struct riff_bank
+static const struct {
+	char id[5];
+	const struct riff_layout *l;
+	size_t offs;     //offset of array pointer
+	size_t offs_n;   //offset of number of entries
+} riff_sf2_tables[] = {
+	{"phdr", &riff_layout_phdr, offsetof(struct riff_bank, presets), offsetof(struct riff_bank, n_presets)},
+	{"pbag", &riff_layout_bag,  offsetof(struct riff_bank, pbags),   offsetof(struct riff_bank, n_pbags)},
+	{"pmod", &riff_layout_mod,  offsetof(struct riff_bank, pmods),   offsetof(struct riff_bank, n_pmods)},
+	{"pgen", &riff_layout_gen,  offsetof(struct riff_bank, pgens),   offsetof(struct riff_bank, n_pgens)},
+	{"inst", &riff_layout_inst, offsetof(struct riff_bank, insts),   offsetof(struct riff_bank, n_insts)},
+	{"ibag", &riff_layout_bag,  offsetof(struct riff_bank, ibags),   offsetof(struct riff_bank, n_ibags)},
+	{"imod", &riff_layout_mod,  offsetof(struct riff_bank, imods),   offsetof(struct riff_bank, n_imods)},
+	{"igen", &riff_layout_gen,  offsetof(struct riff_bank, igens),   offsetof(struct riff_bank, n_igens)},
+};
+
+#define RIFF_SF2_TABLES ((int)(sizeof(riff_sf2_tables) / sizeof(riff_sf2_tables[0])))
+
+
+
+// **** sample cache ****
+
+//cache entry per sample
+struct riff_bankEntry {
+	char *data;     //NULL if not cached
+	int refs;       //number of unreleased riff_bankSampleAcquire() calls
+	int loading;    //1 while a thread reads the sample, others wait for it
+	int prev;       //LRU list of cached samples, -1 at the end
+	int next;
+};
+
+//state of sample cache
+struct riff_bankCache {
+	riff_handle *rh;
+	size_t budget;  //0: no limit
+	size_t used;    //bytes of cached sample data
+	struct riff_bankEntry *e;
+	int head;       //most recently used sample, -1 if none is cached
+	int tail;       //least recently used
+#ifdef RIFF_POSIX
+	pthread_mutex_t mutex;  //protects the cache, not held while reading sample data
+	pthread_cond_t loaded;  //signaled when a sample is read
+#endif
+};
+
+
+
+/*****************************************************************************/
+//read data of current chunk of cursor into allocated buffer, NULL on failure
+void *riff_bankReadChunk(riff_cursor *cur){
+	void *buf = malloc(cur->c_size ? cur->c_size : 1);
+	if(buf == NULL)
+		return NULL;
+	riff_cursorSeekInChunk(cur, 0);
+	if(riff_cursorRead(cur, buf, cur->c_size) != cur->c_size){
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+/*****************************************************************************/
+//decode current chunk of cursor as array of records into newly allocated table, *n receives the number of records
+int riff_bankReadTable(riff_cursor *cur, const struct riff_layout *l, void **table, int *n){
+	size_t cnt = cur->c_size / l->size;
+	void *buf = riff_bankReadChunk(cur);
+	if(buf == NULL)
+		return RIFF_ERROR_EOF;
+	free(*table);  //duplicate chunk, the last one counts
+	*table = malloc(cnt ? cnt * l->size_native : 1);
+	if(*table == NULL){
+		free(buf);
+		return RIFF_ERROR_ACCESS;
+	}
+	riff_decodeArray(l, buf, cnt, cur->rh->be, *table);
+	*n = (int)cnt;
+	free(buf);
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//make room for one more entry in a growing table of "size" byte entries
+int riff_bankGrow(void **table, int n, int *a, size_t size){
+	if(n < *a)
+		return RIFF_ERROR_NONE;
+	int anew = *a ? *a * 2 : RIFF_BANK_ALLOC;
+	void *tnew = realloc(*table, anew * size);
+	if(tnew == NULL)
+		return RIFF_ERROR_ACCESS;
+	*table = tnew;
+	*a = anew;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//enter list of cursor if its type matches, return 1 on success
+int riff_bankEnter(riff_cursor *cur, const char *type){
+	riff_cursor c = *cur;
+	if(strcmp(cur->c_id, "LIST") != 0  ||  riff_cursorLevelSub(&c) != RIFF_ERROR_NONE)
+		return 0;
+	if(memcmp(c.ls[c.ls_level - 1].c_type, type, 4) != 0)
+		return 0;
+	*cur = c;
+	return 1;
+}
+
+/*****************************************************************************/
+//load SF2 tables and sample headers, cursor is at the first chunk of level 0
+int riff_bankLoadSF2(struct riff_bank *b, riff_cursor *cur){
+	struct riff_sf2Shdr *shdr = NULL;
+	int n_shdr = 0;
+	size_t smpl_pos = 0;
+	size_t smpl_size = 0;
+	int r = RIFF_ERROR_NONE;
+	int i;
+
+	do {
+		riff_cursor sub = *cur;
+		if(riff_bankEnter(&sub, "sdta")){
+			do {
+				if(strcmp(sub.c_id, "smpl") == 0){
+					smpl_pos = sub.c_pos_start + RIFF_CHUNK_DATA_OFFSET;
+					smpl_size = sub.c_size;
+				}
+			} while(riff_cursorNextChunk(&sub) == RIFF_ERROR_NONE);
+		}
+		else if(riff_bankEnter(&sub, "pdta")){
+			do {
+				if(strcmp(sub.c_id, "shdr") == 0)
+					r = riff_bankReadTable(&sub, &riff_layout_shdr, (void**)&shdr, &n_shdr);
+				for(i = 0; i < RIFF_SF2_TABLES; i++)
+					if(strcmp(sub.c_id, riff_sf2_tables[i].id) == 0)
+						r = riff_bankReadTable(&sub, riff_sf2_tables[i].l, (void**)((char*)b + riff_sf2_tables[i].offs), (int*)((char*)b + riff_sf2_tables[i].offs_n));
+			} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&sub) == RIFF_ERROR_NONE);
+		}
+	} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(cur) == RIFF_ERROR_NONE);
+
+	if(r != RIFF_ERROR_NONE){
+		free(shdr);
+		return r;
+	}
+
+	//samples without terminal record "EOS", 16 bit mono
+	b->n_samples = n_shdr > 0 ? n_shdr - 1 : 0;
+	b->samples = calloc(b->n_samples ? b->n_samples : 1, sizeof(struct riff_bankSample));
+	if(b->samples == NULL){
+		free(shdr);
+		return RIFF_ERROR_ACCESS;
+	}
+	for(i = 0; i < b->n_samples; i++){
+		struct riff_sf2Shdr *h = shdr + i;
+		struct riff_bankSample *s = b->samples + i;
+		if(h->end < h->start  ||  (size_t)h->end * 2 > smpl_size){
+			r = RIFF_ERROR_ICSIZE;
+			break;
+		}
+		memcpy(s->name, h->name, 21);
+		s->pos = smpl_pos + (size_t)h->start * 2;
+		s->size = (size_t)(h->end - h->start) * 2;
+		s->format_tag = 1;
+		s->channels = 1;
+		s->bits_per_sample = 16;
+		s->sample_rate = h->sample_rate;
+		if(h->start_loop >= h->start  &&  h->end_loop >= h->start_loop  &&  h->end_loop <= h->end){
+			s->loop_start = h->start_loop - h->start;
+			s->loop_end = h->end_loop - h->start;
+		}
+		s->original_pitch = h->original_pitch;
+		s->pitch_correction = h->pitch_correction;
+		s->link = h->link;
+		s->type = h->type;
+	}
+	free(shdr);
+	if(r != RIFF_ERROR_NONE)
+		return r;
+
+	//indices of each level must stay inside the next level
+	for(i = 0; i + 1 < b->n_presets; i++)
+		if(b->presets[i].bag > b->presets[i + 1].bag  ||  b->presets[i + 1].bag >= b->n_pbags)
+			return RIFF_ERROR_ICSIZE;
+	for(i = 0; i + 1 < b->n_insts; i++)
+		if(b->insts[i].bag > b->insts[i + 1].bag  ||  b->insts[i + 1].bag >= b->n_ibags)
+			return RIFF_ERROR_ICSIZE;
+	for(i = 0; i < b->n_pbags; i++)
+		if(b->pbags[i].gen > b->n_pgens  ||  b->pbags[i].mod > b->n_pmods)
+			return RIFF_ERROR_ICSIZE;
+	for(i = 0; i < b->n_ibags; i++)
+		if(b->ibags[i].gen > b->n_igens  ||  b->ibags[i].mod > b->n_imods)
+			return RIFF_ERROR_ICSIZE;
+	for(i = 0; i < b->n_pgens; i++)
+		if(b->pgens[i].oper == 41  &&  b->pgens[i].amount >= b->n_insts)
+			return RIFF_ERROR_ICSIZE;
+	for(i = 0; i < b->n_igens; i++)
+		if(b->igens[i].oper == 53  &&  b->igens[i].amount >= b->n_samples)
+			return RIFF_ERROR_ICSIZE;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//append connection blocks of "art1"/"art2" chunks in articulation list of cursor to the range *first, *n
+//the range is started if *n is 0, else it must end at the last connection (several lists of an instrument or region)
+int riff_bankLoadArt(struct riff_bank *b, riff_cursor *cur, int *a_conn, int *first, int *n){
+	int r = RIFF_ERROR_NONE;
+	if(*n == 0)
+		*first = b->n_connections;
+	do {
+		if(strcmp(cur->c_id, "art1") != 0  &&  strcmp(cur->c_id, "art2") != 0)
+			continue;
+		unsigned char *buf = riff_bankReadChunk(cur);
+		if(buf == NULL)
+			return RIFF_ERROR_EOF;
+		//header: size of header, number of blocks
+		size_t hsize = (cur->c_size >= 8) ? riff_conv32(buf, cur->rh->be) : 0;
+		size_t cnt = (cur->c_size >= 8) ? riff_conv32(buf + 4, cur->rh->be) : 0;
+		if(hsize < 8  ||  hsize > cur->c_size  ||  cnt > (cur->c_size - hsize) / riff_layout_conn.size)
+			r = RIFF_ERROR_ICSIZE;
+		while(r == RIFF_ERROR_NONE  &&  b->n_connections + (int)cnt > *a_conn)
+			r = riff_bankGrow((void**)&b->connections, *a_conn, a_conn, sizeof(struct riff_dlsConnection));
+		if(r == RIFF_ERROR_NONE){
+			riff_decodeArray(&riff_layout_conn, buf + hsize, cnt, cur->rh->be, b->connections + b->n_connections);
+			b->n_connections += (int)cnt;
+		}
+		free(buf);
+	} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(cur) == RIFF_ERROR_NONE);
+	*n = b->n_connections - *first;
+	return r;
+}
+
+/*****************************************************************************/
+//read first loop of "wsmp" chunk into sample
+void riff_bankReadWsmp(riff_cursor *cur, struct riff_bankSample *s){
+	unsigned char buf[36];
+	struct riff_dlsWsmp w;
+	size_t size = cur->c_size < sizeof(buf) ? cur->c_size : sizeof(buf);
+	riff_cursorSeekInChunk(cur, 0);
+	if(riff_cursorRead(cur, buf, size) < riff_layout_wsmp.size)
+		return;
+	riff_decodeArray(&riff_layout_wsmp, buf, 1, cur->rh->be, &w);
+	s->original_pitch = (uint8_t)w.unity_note;
+	s->pitch_correction = (int8_t)w.fine_tune;
+	//loop: size, type, start, length
+	if(w.n_loops > 0  &&  w.size + 16 <= size){
+		unsigned char *l = buf + w.size;
+		s->loop_start = riff_conv32(l + 8, cur->rh->be);
+		s->loop_end = s->loop_start + riff_conv32(l + 12, cur->rh->be);
+	}
+}
+
+/*****************************************************************************/
+//load DLS instruments, regions, articulations and wave headers, cursor is at the first chunk of level 0
+int riff_bankLoadDLS(struct riff_bank *b, riff_cursor *cur){
+	int a_ins = 0, a_rgn = 0, a_conn = 0, a_smp = 0, a_offs = 0;
+	size_t *cues = NULL;    //offsets of waves in "wvpl" data from "ptbl"
+	size_t n_cues = 0;
+	size_t *offs = NULL;    //offset of each loaded wave in "wvpl" data
+	size_t wvpl = 0;
+	int r = RIFF_ERROR_NONE;
+
+	do {
+		riff_cursor sub = *cur;
+		if(strcmp(cur->c_id, "ptbl") == 0){
+			if(cues != NULL){
+				r = RIFF_ERROR_ILLID;  //only one pool table is allowed
+				break;
+			}
+			unsigned char *buf = riff_bankReadChunk(cur);
+			if(buf == NULL){
+				r = RIFF_ERROR_EOF;
+				break;
+			}
+			size_t hsize = (cur->c_size >= 8) ? riff_conv32(buf, cur->rh->be) : 0;
+			n_cues = (cur->c_size >= 8) ? riff_conv32(buf + 4, cur->rh->be) : 0;
+			if(hsize < 8  ||  hsize > cur->c_size  ||  n_cues > (cur->c_size - hsize) / 4)
+				r = RIFF_ERROR_ICSIZE;
+			else if((cues = malloc((n_cues ? n_cues : 1) * sizeof(size_t))) == NULL)
+				r = RIFF_ERROR_ACCESS;
+			else {
+				size_t i;
+				for(i = 0; i < n_cues; i++)
+					cues[i] = riff_conv32(buf + hsize + i * 4, cur->rh->be);
+			}
+			free(buf);
+		}
+		else if(riff_bankEnter(&sub, "lins")){
+			do {
+				riff_cursor ins = sub;
+				if(!riff_bankEnter(&ins, "ins "))
+					continue;
+				if((r = riff_bankGrow((void**)&b->instruments, b->n_instruments, &a_ins, sizeof(struct riff_dlsInstrument))) != RIFF_ERROR_NONE)
+					break;
+				struct riff_dlsInstrument *in = b->instruments + b->n_instruments++;
+				memset(in, 0, sizeof(struct riff_dlsInstrument));
+				in->region = b->n_regions;
+				in->conn = b->n_connections;
+				riff_cursor ins_first = ins;
+
+				do {
+					riff_cursor lst = ins;
+					if(strcmp(ins.c_id, "insh") == 0){
+						unsigned char buf[12];
+						struct riff_dlsInsh h;
+						riff_cursorSeekInChunk(&ins, 0);
+						if(riff_cursorRead(&ins, buf, 12) != 12){
+							r = RIFF_ERROR_EOF;
+							break;
+						}
+						riff_decodeArray(&riff_layout_insh, buf, 1, ins.rh->be, &h);
+						in->bank = h.bank;
+						in->program = h.program;
+					}
+					else if(riff_bankEnter(&lst, "lrgn")){
+						do {
+							riff_cursor rgn = lst;
+							if(!riff_bankEnter(&rgn, "rgn ")  &&  !riff_bankEnter(&rgn, "rgn2"))
+								continue;
+							if((r = riff_bankGrow((void**)&b->regions, b->n_regions, &a_rgn, sizeof(struct riff_dlsRegion))) != RIFF_ERROR_NONE)
+								break;
+							struct riff_dlsRegion *rg = b->regions + b->n_regions++;
+							memset(rg, 0, sizeof(struct riff_dlsRegion));
+							rg->conn = b->n_connections;
+							do {
+								riff_cursor art = rgn;
+								unsigned char buf[12];
+								if(strcmp(rgn.c_id, "rgnh") == 0  ||  strcmp(rgn.c_id, "wlnk") == 0){
+									riff_cursorSeekInChunk(&rgn, 0);
+									if(riff_cursorRead(&rgn, buf, 12) != 12){
+										r = RIFF_ERROR_EOF;
+										break;
+									}
+									if(rgn.c_id[0] == 'r'){
+										struct riff_dlsRegion h;
+										riff_decodeArray(&riff_layout_rgnh, buf, 1, rgn.rh->be, &h);
+										rg->key_lo = h.key_lo;
+										rg->key_hi = h.key_hi;
+										rg->vel_lo = h.vel_lo;
+										rg->vel_hi = h.vel_hi;
+										rg->options = h.options;
+										rg->key_group = h.key_group;
+									}
+									else {
+										struct riff_dlsWlnk w;
+										riff_decodeArray(&riff_layout_wlnk, buf, 1, rgn.rh->be, &w);
+										rg->sample = w.table_index;
+									}
+								}
+								else if(riff_bankEnter(&art, "lart")  ||  riff_bankEnter(&art, "lar2"))
+									r = riff_bankLoadArt(b, &art, &a_conn, &rg->conn, &rg->n_conn);
+							} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&rgn) == RIFF_ERROR_NONE);
+						} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&lst) == RIFF_ERROR_NONE);
+						in->n_regions = b->n_regions - in->region;
+					}
+				} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&ins) == RIFF_ERROR_NONE);
+
+				//global articulation after the regions, so "lart" and "lar2" lists form one range
+				while(r == RIFF_ERROR_NONE){
+					riff_cursor lst = ins_first;
+					if(riff_bankEnter(&lst, "lart")  ||  riff_bankEnter(&lst, "lar2"))
+						r = riff_bankLoadArt(b, &lst, &a_conn, &in->conn, &in->n_conn);
+					if(riff_cursorNextChunk(&ins_first) != RIFF_ERROR_NONE)
+						break;
+				}
+			} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&sub) == RIFF_ERROR_NONE);
+		}
+		else if(riff_bankEnter(&sub, "wvpl")){
+			//wave headers only, data is read on first access
+			wvpl = cur->c_pos_start + RIFF_HEADER_SIZE;
+			do {
+				riff_cursor wave = sub;
+				if(!riff_bankEnter(&wave, "wave"))
+					continue;
+				if((r = riff_bankGrow((void**)&b->samples, b->n_samples, &a_smp, sizeof(struct riff_bankSample))) != RIFF_ERROR_NONE)
+					break;
+				if((r = riff_bankGrow((void**)&offs, b->n_samples, &a_offs, sizeof(size_t))) != RIFF_ERROR_NONE)
+					break;
+				struct riff_bankSample *s = b->samples + b->n_samples;
+				memset(s, 0, sizeof(struct riff_bankSample));
+				offs[b->n_samples++] = sub.c_pos_start - wvpl;
+				do {
+					if(strcmp(wave.c_id, "fmt ") == 0){
+						unsigned char buf[32] = {0};  //cb_size may be missing (PCM)
+						struct riff_fmt fmt;
+						riff_cursorSeekInChunk(&wave, 0);
+						if(riff_cursorRead(&wave, buf, riff_layout_fmt.size) >= 16){
+							riff_decodeArray(&riff_layout_fmt, buf, 1, wave.rh->be, &fmt);
+							s->format_tag = fmt.format_tag;
+							s->channels = fmt.channels;
+							s->bits_per_sample = fmt.bits_per_sample;
+							s->sample_rate = fmt.sample_rate;
+						}
+					}
+					else if(strcmp(wave.c_id, "wsmp") == 0)
+						riff_bankReadWsmp(&wave, s);
+					else if(strcmp(wave.c_id, "data") == 0){
+						s->pos = wave.c_pos_start + RIFF_CHUNK_DATA_OFFSET;
+						s->size = wave.c_size;
+					}
+				} while(riff_cursorNextChunk(&wave) == RIFF_ERROR_NONE);
+			} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(&sub) == RIFF_ERROR_NONE);
+		}
+	} while(r == RIFF_ERROR_NONE  &&  riff_cursorNextChunk(cur) == RIFF_ERROR_NONE);
+
+	//order samples like the pool table, the wave link refers to it
+	if(r == RIFF_ERROR_NONE  &&  cues != NULL){
+		struct riff_bankSample *smp = calloc(n_cues ? n_cues : 1, sizeof(struct riff_bankSample));
+		size_t i;
+		int j;
+		if(smp == NULL)
+			r = RIFF_ERROR_ACCESS;
+		for(i = 0; r == RIFF_ERROR_NONE  &&  i < n_cues; i++){
+			for(j = 0; j < b->n_samples  &&  offs[j] != cues[i]; j++);
+			if(j == b->n_samples)
+				r = RIFF_ERROR_ICSIZE;
+			else
+				smp[i] = b->samples[j];
+		}
+		if(r == RIFF_ERROR_NONE){
+			free(b->samples);
+			b->samples = smp;
+			b->n_samples = (int)n_cues;
+		}
+		else
+			free(smp);
+	}
+	free(cues);
+	free(offs);
+	if(r != RIFF_ERROR_NONE)
+		return r;
+
+	int i;
+	for(i = 0; i < b->n_regions; i++)
+		if(b->regions[i].sample >= (uint32_t)b->n_samples)
+			return RIFF_ERROR_ICSIZE;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+struct riff_bank *riff_bankLoad(riff_handle *rh, size_t budget, int *err){
+	riff_cursor cur;
+	int r = riff_cursorInit(&cur, rh);
+	if(r == RIFF_ERROR_NONE){
+		while(cur.ls_level > 0)
+			riff_cursorLevelParent(&cur);
+		r = riff_cursorLevelStart(&cur);
+	}
+	if(r != RIFF_ERROR_NONE){
+		if(err != NULL)
+			*err = r;
+		return NULL;
+	}
+
+	struct riff_bank *b = calloc(1, sizeof(struct riff_bank));
+	struct riff_bankCache *c = calloc(1, sizeof(struct riff_bankCache));
+	if(b == NULL  ||  c == NULL){
+		free(b);
+		free(c);
+		if(err != NULL)
+			*err = RIFF_ERROR_ACCESS;
+		return NULL;
+	}
+	b->cache = c;
+	c->rh = rh;
+	c->budget = budget;
+	c->head = -1;
+	c->tail = -1;
+#ifdef RIFF_POSIX
+	pthread_mutex_init(&c->mutex, NULL);
+	pthread_cond_init(&c->loaded, NULL);
+#endif
+
+	if(strcmp(rh->h_type, "sfbk") == 0){
+		b->type = RIFF_BANK_SF2;
+		r = riff_bankLoadSF2(b, &cur);
+	}
+	else if(strcmp(rh->h_type, "DLS ") == 0){
+		b->type = RIFF_BANK_DLS;
+		r = riff_bankLoadDLS(b, &cur);
+	}
+	else
+		r = RIFF_ERROR_ILLID;
+
+	if(r == RIFF_ERROR_NONE  &&  (c->e = calloc(b->n_samples ? b->n_samples : 1, sizeof(struct riff_bankEntry))) == NULL)
+		r = RIFF_ERROR_ACCESS;
+
+	if(r != RIFF_ERROR_NONE){
+		riff_bankFree(b);
+		b = NULL;
+	}
+	if(err != NULL)
+		*err = r;
+	return b;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_bankFree(struct riff_bank *b){
+	if(b == NULL)
+		return;
+	struct riff_bankCache *c = (struct riff_bankCache*)b->cache;
+	if(c != NULL){
+		if(c->e != NULL){
+			int i;
+			for(i = 0; i < b->n_samples; i++)
+				free(c->e[i].data);
+			free(c->e);
+		}
+#ifdef RIFF_POSIX
+		pthread_mutex_destroy(&c->mutex);
+		pthread_cond_destroy(&c->loaded);
+#endif
+		free(c);
+	}
+	free(b->samples);
+	free(b->presets);
+	free(b->pbags);
+	free(b->pmods);
+	free(b->pgens);
+	free(b->insts);
+	free(b->ibags);
+	free(b->imods);
+	free(b->igens);
+	free(b->instruments);
+	free(b->regions);
+	free(b->connections);
+	free(b);
+}
+
+
+
+/*****************************************************************************/
+//remove sample from LRU list
+void riff_bankUnlink(struct riff_bankCache *c, int i){
+	struct riff_bankEntry *e = c->e + i;
+	if(e->prev >= 0)
+		c->e[e->prev].next = e->next;
+	else
+		c->head = e->next;
+	if(e->next >= 0)
+		c->e[e->next].prev = e->prev;
+	else
+		c->tail = e->prev;
+}
+
+/*****************************************************************************/
+//insert sample at head of LRU list (most recently used)
+void riff_bankLinkHead(struct riff_bankCache *c, int i){
+	struct riff_bankEntry *e = c->e + i;
+	e->prev = -1;
+	e->next = c->head;
+	if(c->head >= 0)
+		c->e[c->head].prev = i;
+	else
+		c->tail = i;
+	c->head = i;
+}
+
+/*****************************************************************************/
+//evict least recently used samples not in use until "size" more bytes fit into the budget
+void riff_bankEvict(struct riff_bank *b, size_t size){
+	struct riff_bankCache *c = (struct riff_bankCache*)b->cache;
+	int i = c->tail;
+	while(i >= 0  &&  c->used + size > c->budget){
+		int prev = c->e[i].prev;
+		if(c->e[i].refs == 0){
+			riff_bankUnlink(c, i);
+			free(c->e[i].data);
+			c->e[i].data = NULL;
+			c->used -= b->samples[i].size;
+		}
+		i = prev;
+	}
+}
+
+/*****************************************************************************/
+//description: see header file
+const void *riff_bankSampleAcquire(struct riff_bank *b, int i){
+	if(b == NULL  ||  i < 0  ||  i >= b->n_samples)
+		return NULL;
+	struct riff_bankCache *c = (struct riff_bankCache*)b->cache;
+	struct riff_bankEntry *e = c->e + i;
+	const struct riff_bankSample *s = b->samples + i;
+
+#ifdef RIFF_POSIX
+	pthread_mutex_lock(&c->mutex);
+	while(e->loading)
+		pthread_cond_wait(&c->loaded, &c->mutex);
+#endif
+	if(e->data != NULL)
+		riff_bankUnlink(c, i);
+	else {
+		//page in on first access, the size is reserved in the budget while reading
+		if(c->budget > 0)
+			riff_bankEvict(b, s->size);
+		c->used += s->size;
+		e->loading = 1;
+#ifdef RIFF_POSIX
+		//other samples can be acquired meanwhile, the stream position of a handle without fp_readv is shared though
+		int unlock = (c->rh->fp_readv != NULL);
+		if(unlock)
+			pthread_mutex_unlock(&c->mutex);
+#endif
+		char *buf = malloc(s->size ? s->size : 1);
+		if(buf != NULL  &&  riff_readAt(c->rh, buf, s->size, s->pos) != s->size){
+			free(buf);
+			buf = NULL;
+		}
+#ifdef RIFF_POSIX
+		if(unlock)
+			pthread_mutex_lock(&c->mutex);
+#endif
+		e->loading = 0;
+		e->data = buf;
+		if(e->data == NULL)
+			c->used -= s->size;
+#ifdef RIFF_POSIX
+		pthread_cond_broadcast(&c->loaded);
+#endif
+	}
+	if(e->data != NULL){
+		riff_bankLinkHead(c, i);
+		e->refs++;
+	}
+	const void *data = e->data;
+#ifdef RIFF_POSIX
+	pthread_mutex_unlock(&c->mutex);
+#endif
+	return data;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_bankSampleRelease(struct riff_bank *b, int i){
+	if(b == NULL  ||  i < 0  ||  i >= b->n_samples)
+		return;
+	struct riff_bankCache *c = (struct riff_bankCache*)b->cache;
+#ifdef RIFF_POSIX
+	pthread_mutex_lock(&c->mutex);
+#endif
+	if(c->e[i].refs > 0)
+		c->e[i].refs--;
+#ifdef RIFF_POSIX
+	pthread_mutex_unlock(&c->mutex);
+#endif
+}
+
+/*****************************************************************************/
+//description: see header file
+size_t riff_bankCached(struct riff_bank *b){
+	return ((struct riff_bankCache*)b->cache)->used;
+}
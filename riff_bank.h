@@ -0,0 +1,190 @@
+/*
+libriff - sound banks
+
+Author/copyright: Markus Wolf
+License: zlib (https://opensource.org/licenses/Zlib)
+
+
+Load SoundFont 2 ("RIFF" "sfbk") and DLS ("RIFF" "DLS ") banks for synthesizers.
+The articulation hierarchy ("pdta" of SF2, "lins" of DLS) is parsed on loading into compact arrays.
+Sample data ("sdta", "wvpl") is not read on loading, each sample is read on first access and stays cached,
+optionally limited by a memory budget, least recently used samples are evicted first.
+
+Usage:
+Open the bank file with a riff_handle and call riff_bankLoad(), the handle must stay open while the bank is used.
+Get the data of a sample with riff_bankSampleAcquire() and give it back with riff_bankSampleRelease() when it is not played anymore.
+Samples in use are never evicted, so the budget can be exceeded if all cached samples are in use.
+*/
+
+
+
+
+#ifndef _RIFF_BANK_H_
+#define _RIFF_BANK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "riff.h"
+
+
+
+#define RIFF_BANK_SF2 1
+#define RIFF_BANK_DLS 2
+
+
+//sample of SF2 ("shdr") or DLS ("wave" in "wvpl")
+struct riff_bankSample {
+	char name[21];             //SF2 only, empty for DLS
+	size_t pos;                //stream position of sample data
+	size_t size;               //size of sample data in bytes
+	uint16_t format_tag;       //1: PCM
+	uint16_t channels;
+	uint16_t bits_per_sample;
+	uint32_t sample_rate;
+	uint32_t loop_start;       //in sample frames from start of sample
+	uint32_t loop_end;         //exclusive, equals loop_start if there is no loop
+	uint8_t original_pitch;    //MIDI key of recorded pitch (DLS: unity note)
+	int8_t pitch_correction;   //cents
+	uint16_t link;             //SF2: index of linked sample (stereo)
+	uint16_t type;             //SF2: sample type (1: mono, 2: right, 4: left, 8: linked)
+};
+
+
+// **** SF2 "pdta" tables ****
+//entries are linked by indices like in the file: the range of entry i ends at the first index of entry i + 1,
+//so the tables of presets, instruments and bags keep their terminal record ("EOP", "EOI") as last entry
+
+//"phdr"
+struct riff_sf2Preset {
+	char name[21];
+	uint16_t preset;           //MIDI program
+	uint16_t bank;             //MIDI bank
+	uint16_t bag;              //first index in pbags
+	uint32_t library;
+	uint32_t genre;
+	uint32_t morphology;
+};
+
+//"inst"
+struct riff_sf2Inst {
+	char name[21];
+	uint16_t bag;              //first index in ibags
+};
+
+//"pbag", "ibag"
+struct riff_sf2Bag {
+	uint16_t gen;              //first index in pgens/igens
+	uint16_t mod;              //first index in pmods/imods
+};
+
+//"pmod", "imod"
+struct riff_sf2Mod {
+	uint16_t src;
+	uint16_t dest;
+	int16_t amount;
+	uint16_t amount_src;
+	uint16_t transform;
+};
+
+//"pgen", "igen"
+struct riff_sf2Gen {
+	uint16_t oper;             //generator, 41: instrument (index in insts), 53: sample ID (index in samples)
+	uint16_t amount;           //ranges (43, 44): low byte low value, high byte high value; cast to int16_t for signed values
+};
+
+
+// **** DLS "lins" tables ****
+
+//"ins "
+struct riff_dlsInstrument {
+	uint32_t bank;             //MIDI bank (CC0/CC32), bit 31 set for drum instruments
+	uint32_t program;
+	int region;                //first index in regions
+	int n_regions;
+	int conn;                  //first index in connections, global articulation of the instrument
+	int n_conn;
+};
+
+//"rgn ", "rgn2"
+struct riff_dlsRegion {
+	uint16_t key_lo;
+	uint16_t key_hi;
+	uint16_t vel_lo;
+	uint16_t vel_hi;
+	uint16_t options;
+	uint16_t key_group;
+	uint32_t sample;           //index in samples ("wlnk" table index)
+	int conn;                  //first index in connections, articulation of the region
+	int n_conn;
+};
+
+//connection block of "art1", "art2"
+struct riff_dlsConnection {
+	uint16_t source;
+	uint16_t control;
+	uint16_t destination;
+	uint16_t transform;
+	int32_t scale;
+};
+
+
+//loaded bank, members are for read access
+struct riff_bank {
+	int type;                       //RIFF_BANK_SF2 or RIFF_BANK_DLS
+
+	struct riff_bankSample *samples;
+	int n_samples;
+
+	//SF2
+	struct riff_sf2Preset *presets;
+	int n_presets;
+	struct riff_sf2Bag *pbags;
+	int n_pbags;
+	struct riff_sf2Mod *pmods;
+	int n_pmods;
+	struct riff_sf2Gen *pgens;
+	int n_pgens;
+	struct riff_sf2Inst *insts;
+	int n_insts;
+	struct riff_sf2Bag *ibags;
+	int n_ibags;
+	struct riff_sf2Mod *imods;
+	int n_imods;
+	struct riff_sf2Gen *igens;
+	int n_igens;
+
+	//DLS
+	struct riff_dlsInstrument *instruments;
+	int n_instruments;
+	struct riff_dlsRegion *regions;
+	int n_regions;
+	struct riff_dlsConnection *connections;
+	int n_connections;
+
+	void *cache;  //for internal use: sample cache
+};
+
+
+
+//load bank from an opened handle, the handle's position is not changed (positioned reads)
+//budget: max. bytes of cached sample data, 0 for no limit
+//err receives the error code (may be NULL), RIFF_ERROR_ILLID if the file is no SF2 or DLS bank, RIFF_ERROR_ICSIZE for invalid indices
+//returns NULL on error, free the bank with riff_bankFree()
+struct riff_bank *riff_bankLoad(riff_handle *rh, size_t budget, int *err);
+void riff_bankFree(struct riff_bank *b);
+
+//return data of sample (raw PCM as stored in the file), read on first access; NULL on read error
+//every successful call must be paired with riff_bankSampleRelease(), the data stays valid until then
+//thread safe with RIFF_POSIX only (pthreads), without it calls must not overlap;
+//samples are read in parallel to other calls if the handle supports positioned reads (fp_readv)
+const void *riff_bankSampleAcquire(struct riff_bank *b, int i);
+void riff_bankSampleRelease(struct riff_bank *b, int i);
+
+//number of bytes of cached sample data
+size_t riff_bankCached(struct riff_bank *b);
+
+
+
+
+#endif // _RIFF_BANK_H_
@@ -0,0 +1,332 @@
+// typed chunk decoders, see "riff_decode.h"
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "riff.h"
+#include "riff_decode.h"
+
+
+//host byte order, chunk data is converted only if the file's byte order differs (rh->be)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define RIFF_HOST_BE 1
+#else
+#define RIFF_HOST_BE 0
+#endif
+
+#define RIFF_LAYOUT_BUFSIZE 1024  //max. chunk data size of a layout decoded via stack buffer, larger ones are allocated
+
+
+//*** built in layouts ***
+
+
+static const struct riff_field riff_fields_fmt[] = {
+	RIFF_FIELD( 0, struct riff_fmt, format_tag, 1),
+	RIFF_FIELD( 2, struct riff_fmt, channels, 1),
+	RIFF_FIELD( 4, struct riff_fmt, sample_rate, 1),
+	RIFF_FIELD( 8, struct riff_fmt, byte_rate, 1),
+	RIFF_FIELD(12, struct riff_fmt, block_align, 1),
+	RIFF_FIELD(14, struct riff_fmt, bits_per_sample, 1),
+	RIFF_FIELD(16, struct riff_fmt, cb_size, 1),
+};
+const struct riff_layout riff_layout_fmt = {"fmt ", 18, sizeof(struct riff_fmt), riff_fields_fmt, 7, 1};
+
+static const struct riff_field riff_fields_avih[] = {
+	RIFF_FIELD( 0, struct riff_avih, micro_sec_per_frame, 1),
+	RIFF_FIELD( 4, struct riff_avih, max_bytes_per_sec, 1),
+	RIFF_FIELD( 8, struct riff_avih, padding_granularity, 1),
+	RIFF_FIELD(12, struct riff_avih, flags, 1),
+	RIFF_FIELD(16, struct riff_avih, total_frames, 1),
+	RIFF_FIELD(20, struct riff_avih, initial_frames, 1),
+	RIFF_FIELD(24, struct riff_avih, streams, 1),
+	RIFF_FIELD(28, struct riff_avih, suggested_buffer_size, 1),
+	RIFF_FIELD(32, struct riff_avih, width, 1),
+	RIFF_FIELD(36, struct riff_avih, height, 1),
+	RIFF_FIELD(40, struct riff_avih, reserved[0], 1),
+	RIFF_FIELD(44, struct riff_avih, reserved[1], 1),
+	RIFF_FIELD(48, struct riff_avih, reserved[2], 1),
+	RIFF_FIELD(52, struct riff_avih, reserved[3], 1),
+};
+const struct riff_layout riff_layout_avih = {"avih", 56, sizeof(struct riff_avih), riff_fields_avih, 14, 1};
+
+static const struct riff_field riff_fields_strh[] = {
+	RIFF_FIELD( 0, struct riff_strh, fcc_type, 0),
+	RIFF_FIELD( 4, struct riff_strh, fcc_handler, 0),
+	RIFF_FIELD( 8, struct riff_strh, flags, 1),
+	RIFF_FIELD(12, struct riff_strh, priority, 1),
+	RIFF_FIELD(14, struct riff_strh, language, 1),
+	RIFF_FIELD(16, struct riff_strh, initial_frames, 1),
+	RIFF_FIELD(20, struct riff_strh, scale, 1),
+	RIFF_FIELD(24, struct riff_strh, rate, 1),
+	RIFF_FIELD(28, struct riff_strh, start, 1),
+	RIFF_FIELD(32, struct riff_strh, length, 1),
+	RIFF_FIELD(36, struct riff_strh, suggested_buffer_size, 1),
+	RIFF_FIELD(40, struct riff_strh, quality, 1),
+	RIFF_FIELD(44, struct riff_strh, sample_size, 1),
+	RIFF_FIELD(48, struct riff_strh, frame_left, 1),
+	RIFF_FIELD(50, struct riff_strh, frame_top, 1),
+	RIFF_FIELD(52, struct riff_strh, frame_right, 1),
+	RIFF_FIELD(54, struct riff_strh, frame_bottom, 1),
+};
+const struct riff_layout riff_layout_strh = {"strh", 56, sizeof(struct riff_strh), riff_fields_strh, 17, 1};
+
+static const struct riff_field riff_fields_strf_vids[] = {
+	RIFF_FIELD( 0, struct riff_strf_vids, size, 1),
+	RIFF_FIELD( 4, struct riff_strf_vids, width, 1),
+	RIFF_FIELD( 8, struct riff_strf_vids, height, 1),
+	RIFF_FIELD(12, struct riff_strf_vids, planes, 1),
+	RIFF_FIELD(14, struct riff_strf_vids, bit_count, 1),
+	RIFF_FIELD(16, struct riff_strf_vids, compression, 0),
+	RIFF_FIELD(20, struct riff_strf_vids, size_image, 1),
+	RIFF_FIELD(24, struct riff_strf_vids, x_pels_per_meter, 1),
+	RIFF_FIELD(28, struct riff_strf_vids, y_pels_per_meter, 1),
+	RIFF_FIELD(32, struct riff_strf_vids, clr_used, 1),
+	RIFF_FIELD(36, struct riff_strf_vids, clr_important, 1),
+};
+const struct riff_layout riff_layout_strf_vids = {"strf", 40, sizeof(struct riff_strf_vids), riff_fields_strf_vids, 11, 1};
+
+//not direct: integers after the texts are only 2 byte aligned in the chunk
+static const struct riff_field riff_fields_bext[] = {
+	RIFF_FIELD(  0, struct riff_bext, description, 0),
+	RIFF_FIELD(256, struct riff_bext, originator, 0),
+	RIFF_FIELD(288, struct riff_bext, originator_reference, 0),
+	RIFF_FIELD(320, struct riff_bext, origination_date, 0),
+	RIFF_FIELD(330, struct riff_bext, origination_time, 0),
+	RIFF_FIELD(338, struct riff_bext, time_reference_low, 1),
+	RIFF_FIELD(342, struct riff_bext, time_reference_high, 1),
+	RIFF_FIELD(346, struct riff_bext, version, 1),
+	RIFF_FIELD(348, struct riff_bext, umid, 0),
+	RIFF_FIELD(412, struct riff_bext, loudness_value, 1),
+	RIFF_FIELD(414, struct riff_bext, loudness_range, 1),
+	RIFF_FIELD(416, struct riff_bext, max_true_peak_level, 1),
+	RIFF_FIELD(418, struct riff_bext, max_momentary_loudness, 1),
+	RIFF_FIELD(420, struct riff_bext, max_short_term_loudness, 1),
+};
+const struct riff_layout riff_layout_bext = {"bext", 602, sizeof(struct riff_bext), riff_fields_bext, 14, 0};
+
+
+//layouts found by chunk ID
+static const struct riff_layout *riff_layouts[] = {
+	&riff_layout_fmt,
+	&riff_layout_avih,
+	&riff_layout_strh,
+	&riff_layout_bext,
+};
+
+//user registered layouts
+static const struct riff_layout *riff_layouts_user[RIFF_LAYOUT_MAX];
+static int riff_layouts_user_n = 0;
+
+
+//"INFO" sub chunk IDs and the corresponding member of struct riff_info
+static const struct {
+	char id[5];
+	size_t offs;
+} riff_info_ids[] = {
+	{"IARL", offsetof(struct riff_info, archival_location)},
+	{"IART", offsetof(struct riff_info, artist)},
+	{"ICMS", offsetof(struct riff_info, commissioned)},
+	{"ICMT", offsetof(struct riff_info, comment)},
+	{"ICOP", offsetof(struct riff_info, copyright)},
+	{"ICRD", offsetof(struct riff_info, creation_date)},
+	{"IENG", offsetof(struct riff_info, engineer)},
+	{"IGNR", offsetof(struct riff_info, genre)},
+	{"IKEY", offsetof(struct riff_info, keywords)},
+	{"IMED", offsetof(struct riff_info, medium)},
+	{"INAM", offsetof(struct riff_info, name)},
+	{"IPRD", offsetof(struct riff_info, product)},
+	{"ISBJ", offsetof(struct riff_info, subject)},
+	{"ISFT", offsetof(struct riff_info, software)},
+	{"ISRC", offsetof(struct riff_info, source)},
+	{"ITCH", offsetof(struct riff_info, technician)},
+	{"ITRK", offsetof(struct riff_info, track)},
+};
+
+#define RIFF_INFO_IDS ((int)(sizeof(riff_info_ids) / sizeof(riff_info_ids[0])))
+
+
+
+
+/*****************************************************************************/
+//return 1 if the chunk data of the layout can be read directly into the native struct:
+//the fields are in order and fill l->size without gaps (struct padding), each at the same offset in the native struct
+int riff_layoutIsDirect(const struct riff_layout *l){
+	size_t end = 0;
+	int i;
+	for(i = 0; i < l->n_fields; i++){
+		const struct riff_field *f = l->fields + i;
+		if(f->offs != end  ||  f->offs_native != f->offs)
+			return 0;
+		end += f->size;
+	}
+	return end == l->size  &&  l->size <= l->size_native;
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_layoutRegister(const struct riff_layout *l){
+	if(l->direct  &&  !riff_layoutIsDirect(l))
+		return RIFF_ERROR_ILLID;
+	if(riff_layouts_user_n >= RIFF_LAYOUT_MAX)
+		return RIFF_ERROR_ACCESS;
+	riff_layouts_user[riff_layouts_user_n++] = l;
+	return RIFF_ERROR_NONE;
+}
+
+/*****************************************************************************/
+//description: see header file
+const struct riff_layout *riff_layoutFind(const char *id){
+	int i;
+	for(i = riff_layouts_user_n - 1; i >= 0; i--)
+		if(memcmp(riff_layouts_user[i]->id, id, 4) == 0)
+			return riff_layouts_user[i];
+	for(i = 0; i < (int)(sizeof(riff_layouts) / sizeof(riff_layouts[0])); i++)
+		if(memcmp(riff_layouts[i]->id, id, 4) == 0)
+			return riff_layouts[i];
+	return NULL;
+}
+
+/*****************************************************************************/
+//copy fields from chunk data to native struct, only fields completely inside "size" bytes
+void riff_decodeFields(const struct riff_layout *l, const unsigned char *data, size_t size, unsigned char *out){
+	const struct riff_field *f = l->fields;
+	const struct riff_field *fend = f + l->n_fields;
+	for(; f < fend; f++){
+		if(f->offs + f->size > size)
+			continue;
+		memcpy(out + f->offs_native, data + f->offs, f->size);
+	}
+}
+
+/*****************************************************************************/
+//swap byte order of all integer fields in native struct
+void riff_swapFields(const struct riff_layout *l, unsigned char *out){
+	const struct riff_field *f = l->fields;
+	const struct riff_field *fend = f + l->n_fields;
+	for(; f < fend; f++){
+		if(!f->swap)
+			continue;
+		unsigned char *p = out + f->offs_native;
+		int i;
+		for(i = 0; i < f->size / 2; i++){
+			unsigned char t = p[i];
+			p[i] = p[f->size - 1 - i];
+			p[f->size - 1 - i] = t;
+		}
+	}
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_decodeChunk(riff_handle *rh, const struct riff_layout *l, void *out){
+	if(rh == NULL  ||  out == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	if(l == NULL  &&  (l = riff_layoutFind(rh->c_id)) == NULL)
+		return RIFF_ERROR_ILLID;
+
+	size_t size = rh->c_size < l->size ? rh->c_size : l->size;
+	memset(out, 0, l->size_native);
+	riff_seekInChunk(rh, 0);
+
+	//read directly into struct
+	if(l->direct){
+		size_t n = riff_readInChunk(rh, out, size);
+		if(rh->be != RIFF_HOST_BE)
+			riff_swapFields(l, (unsigned char*)out);
+		return (n == size) ? RIFF_ERROR_NONE : RIFF_ERROR_EOF;
+	}
+
+	unsigned char stackbuf[RIFF_LAYOUT_BUFSIZE];
+	unsigned char *buf = stackbuf;
+	if(size > RIFF_LAYOUT_BUFSIZE  &&  (buf = malloc(size)) == NULL)
+		return RIFF_ERROR_ACCESS;
+
+	size_t n = riff_readInChunk(rh, buf, size);
+	riff_decodeFields(l, buf, n, (unsigned char*)out);
+	if(rh->be != RIFF_HOST_BE)
+		riff_swapFields(l, (unsigned char*)out);
+
+	if(buf != stackbuf)
+		free(buf);
+	return (n == size) ? RIFF_ERROR_NONE : RIFF_ERROR_EOF;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_decodeArray(const struct riff_layout *l, const void *data, size_t n, int be, void *out){
+	const unsigned char *d = (const unsigned char*)data;
+	unsigned char *o = (unsigned char*)out;
+	size_t i;
+	memset(out, 0, n * l->size_native);
+	for(i = 0; i < n; i++){
+		riff_decodeFields(l, d + i * l->size, l->size, o + i * l->size_native);
+		if(be != RIFF_HOST_BE)
+			riff_swapFields(l, o + i * l->size_native);
+	}
+}
+
+/*****************************************************************************/
+//description: see header file
+int riff_decodeInfo(riff_handle *rh, struct riff_info *info){
+	if(rh == NULL  ||  info == NULL)
+		return RIFF_ERROR_INVALID_HANDLE;
+	memset(info, 0, sizeof(struct riff_info));
+	if(strcmp(rh->c_id, "LIST") != 0  ||  rh->c_size < 4)
+		return RIFF_ERROR_ILLID;
+
+	//list data with space for terminator of last text
+	info->buf = malloc(rh->c_size + 1);
+	if(info->buf == NULL)
+		return RIFF_ERROR_ACCESS;
+
+	riff_seekInChunk(rh, 0);
+	size_t size = riff_readInChunk(rh, info->buf, rh->c_size);
+	if(size < 4  ||  memcmp(info->buf, "INFO", 4) != 0){
+		riff_infoFree(info);
+		return (size < 4) ? RIFF_ERROR_EOF : RIFF_ERROR_ILLID;
+	}
+
+	//texts are terminated after all sub chunk headers were read, the terminator may overwrite the following header
+	//end per known ID, the last sub chunk of an ID wins
+	size_t ends[RIFF_INFO_IDS];
+	size_t pos = 4;
+	int r = RIFF_ERROR_NONE;
+
+	while(pos + RIFF_CHUNK_DATA_OFFSET <= size){
+		const char *id = info->buf + pos;
+		size_t len = riff_conv32(info->buf + pos + 4, rh->be);
+		size_t data = pos + RIFF_CHUNK_DATA_OFFSET;
+		if(len > size - data){
+			r = RIFF_ERROR_ICSIZE;
+			break;
+		}
+
+		int i;
+		for(i = 0; i < RIFF_INFO_IDS; i++){
+			if(memcmp(riff_info_ids[i].id, id, 4) == 0){
+				*(const char**)((char*)info + riff_info_ids[i].offs) = info->buf + data;
+				ends[i] = data + len;
+				break;
+			}
+		}
+		pos = data + len + (len & 0x1);
+	}
+
+	int i;
+	for(i = 0; i < RIFF_INFO_IDS; i++)
+		if(*(const char**)((char*)info + riff_info_ids[i].offs) != NULL)
+			info->buf[ends[i]] = '\0';
+
+	return r;
+}
+
+/*****************************************************************************/
+//description: see header file
+void riff_infoFree(struct riff_info *info){
+	if(info == NULL)
+		return;
+	free(info->buf);
+	memset(info, 0, sizeof(struct riff_info));
+}
@@ -0,0 +1,200 @@
+/*
+libriff - typed chunk decoders
+
+Author/copyright: Markus Wolf
+License: zlib (https://opensource.org/licenses/Zlib)
+
+
+Decode well known chunks into native structs with one read.
+Each chunk type is described by a layout: a table of fields with their offset in the chunk data and in the native struct.
+The table is built at compile time via RIFF_FIELD().
+Integers are converted only if the byte order of the file (little endian, big endian for "RIFX") differs from the host;
+if the native struct has the same layout as the chunk data, the data is read directly into the struct.
+
+Usage:
+Navigate to a chunk (e.g. "fmt ") and call riff_decodeChunk(rh, NULL, &fmt), the layout is looked up by chunk ID.
+For chunks depending on context ("strf"), pass the layout explicitly.
+Register own layouts with riff_layoutRegister(), they take precedence over the built in ones.
+*/
+
+
+
+
+#ifndef _RIFF_DECODE_H_
+#define _RIFF_DECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "riff.h"
+
+
+
+#define RIFF_LAYOUT_MAX 32  //max. number of user registered layouts
+
+
+//field of a chunk layout
+struct riff_field {
+	unsigned short offs;         //offset in chunk data
+	unsigned short offs_native;  //offset in native struct
+	unsigned short size;         //size in bytes
+	unsigned char swap;          //1: integer in file byte order, 0: bytes (FOURCC, text)
+};
+
+//define field of native struct "type" at chunk data offset "offs"
+#define RIFF_FIELD(offs, type, member, swap)  { (offs), offsetof(type, member), sizeof(((type*)0)->member), (swap) }
+
+//chunk layout
+struct riff_layout {
+	char id[5];                      //chunk ID
+	size_t size;                     //size of chunk data covered by the fields
+	size_t size_native;              //size of native struct
+	const struct riff_field *fields; //field table
+	int n_fields;                    //number of fields
+	int direct;                      //1 if the fields fill the chunk data in order, each at the same offset in the native struct -> read directly into struct
+};
+
+
+
+// **** native structs of built in layouts ****
+
+//"fmt " of WAVE, also "strf" of audio streams in AVI (WAVEFORMATEX)
+struct riff_fmt {
+	uint16_t format_tag;       //1: PCM
+	uint16_t channels;
+	uint32_t sample_rate;
+	uint32_t byte_rate;        //average bytes per second
+	uint16_t block_align;
+	uint16_t bits_per_sample;
+	uint16_t cb_size;          //size of extra format data, 0 if not present (PCM)
+};
+
+//"avih" of AVI (MainAVIHeader)
+struct riff_avih {
+	uint32_t micro_sec_per_frame;
+	uint32_t max_bytes_per_sec;
+	uint32_t padding_granularity;
+	uint32_t flags;
+	uint32_t total_frames;
+	uint32_t initial_frames;
+	uint32_t streams;
+	uint32_t suggested_buffer_size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved[4];
+};
+
+//"strh" of AVI (AVIStreamHeader)
+struct riff_strh {
+	char fcc_type[4];          //"vids", "auds", ...
+	char fcc_handler[4];
+	uint32_t flags;
+	uint16_t priority;
+	uint16_t language;
+	uint32_t initial_frames;
+	uint32_t scale;
+	uint32_t rate;             //rate / scale = samples per second
+	uint32_t start;
+	uint32_t length;
+	uint32_t suggested_buffer_size;
+	uint32_t quality;
+	uint32_t sample_size;
+	int16_t frame_left;
+	int16_t frame_top;
+	int16_t frame_right;
+	int16_t frame_bottom;
+};
+
+//"strf" of video streams in AVI (BITMAPINFOHEADER)
+struct riff_strf_vids {
+	uint32_t size;
+	int32_t width;
+	int32_t height;
+	uint16_t planes;
+	uint16_t bit_count;
+	char compression[4];       //FOURCC or 0 for RGB
+	uint32_t size_image;
+	int32_t x_pels_per_meter;
+	int32_t y_pels_per_meter;
+	uint32_t clr_used;
+	uint32_t clr_important;
+};
+
+//"bext" of Broadcast WAVE (BWF), fixed part, coding history follows at chunk offset 602
+struct riff_bext {
+	char description[256];
+	char originator[32];
+	char originator_reference[32];
+	char origination_date[10];  //yyyy-mm-dd
+	char origination_time[8];   //hh-mm-ss
+	uint32_t time_reference_low;
+	uint32_t time_reference_high;
+	uint16_t version;
+	unsigned char umid[64];
+	int16_t loudness_value;
+	int16_t loudness_range;
+	int16_t max_true_peak_level;
+	int16_t max_momentary_loudness;
+	int16_t max_short_term_loudness;
+};
+
+//"LIST" "INFO", texts of known sub chunks, NULL if not present
+struct riff_info {
+	const char *archival_location;  //IARL
+	const char *artist;             //IART
+	const char *commissioned;       //ICMS
+	const char *comment;            //ICMT
+	const char *copyright;          //ICOP
+	const char *creation_date;      //ICRD
+	const char *engineer;           //IENG
+	const char *genre;              //IGNR
+	const char *keywords;           //IKEY
+	const char *medium;             //IMED
+	const char *name;               //INAM
+	const char *product;            //IPRD
+	const char *subject;            //ISBJ
+	const char *software;           //ISFT
+	const char *source;             //ISRC
+	const char *technician;         //ITCH
+	const char *track;              //ITRK
+
+	char *buf;                      //for internal use: list data the texts point to
+};
+
+
+//built in layouts
+extern const struct riff_layout riff_layout_fmt;        //"fmt ", use for "strf" of audio streams too
+extern const struct riff_layout riff_layout_avih;
+extern const struct riff_layout riff_layout_strh;
+extern const struct riff_layout riff_layout_strf_vids;  //"strf" of video streams
+extern const struct riff_layout riff_layout_bext;
+
+
+
+//register user layout, the layout must stay valid; not thread safe, register before decoding
+//returns RIFF_ERROR_NONE, RIFF_ERROR_ILLID if "direct" is set but the fields don't fill the chunk data in order at the same offsets as in the struct,
+//RIFF_ERROR_ACCESS if RIFF_LAYOUT_MAX layouts are registered already
+int riff_layoutRegister(const struct riff_layout *l);
+
+//find layout by chunk ID (4 chars), user layouts first; returns NULL if unknown
+const struct riff_layout *riff_layoutFind(const char *id);
+
+//decode current chunk into native struct "out" with one read from chunk data offset 0
+//l: layout, NULL to find it by chunk ID
+//fields not covered by a shorter chunk are set to 0
+//returns error code, RIFF_ERROR_ILLID if no layout is found
+int riff_decodeChunk(riff_handle *rh, const struct riff_layout *l, void *out);
+
+//decode array of "n" records of l->size bytes in memory (e.g. the tables of a sound bank) into native structs
+//be: byte order of data (rh->be)
+void riff_decodeArray(const struct riff_layout *l, const void *data, size_t n, int be, void *out);
+
+//decode current "LIST" "INFO" chunk with one read, free with riff_infoFree()
+int riff_decodeInfo(riff_handle *rh, struct riff_info *info);
+void riff_infoFree(struct riff_info *info);
+
+
+
+
+#endif // _RIFF_DECODE_H_